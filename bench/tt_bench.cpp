@@ -0,0 +1,283 @@
+// tt_bench: times the store's hot paths on synthetic stores.
+//
+//   tt_bench [--sizes=1000,10000,...] [--reps=N] [--ops=N] [--only=NAME] [--dir=PATH] [--tt=PATH]
+//
+// each size gets a fresh store in a scratch directory. bulk operations report
+// the median of --reps runs and tasks/s; per-command operations (done, rm,
+// add) run --ops commands and report median and p99 latency. startup/* spawns
+// the tt binary itself --ops times, for the cost of a whole invocation.
+//
+// links libtt, so the benchmarks call exactly the functions tt runs.
+#include "tt_internal.h"
+
+#include <chrono>
+#include <random>
+
+#if defined(TT_HAVE_POSIX_IO)
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+using namespace tt;
+
+// swallows output so printing is measured without the terminal
+class NullBuf : public std::streambuf {
+protected:
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+    int overflow(int c) override { return c; }
+};
+
+struct Options {
+    std::vector<size_t> sizes{1000, 10000, 100000, 1000000};
+    int reps = 5;
+    int ops = 200;
+    std::string only;
+    fs::path dir;
+    fs::path tt; // the tt binary for the startup benchmarks
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double ms_since(Clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = static_cast<size_t>(p * static_cast<double>(v.size() - 1) + 0.5);
+    return v[i];
+}
+
+static void report(const std::string& name, size_t n, const std::vector<double>& ms, size_t items) {
+    double med = percentile(ms, 0.5);
+    double rate = med > 0 ? static_cast<double>(items) / (med / 1000.0) : 0;
+    std::printf("%-22s %10zu %8zu %12.3f %12.3f %14.0f\n", name.c_str(), n, ms.size(), med, percentile(ms, 0.99),
+                rate);
+    std::fflush(stdout);
+}
+
+// a store shaped like real use: most tasks pending, mostly medium priority,
+// about a third undated and the rest clustered within a few months of today
+static std::vector<Task> synth_tasks(size_t n, TitleArena& arena, std::mt19937& rng) {
+    static const char* words[] = {"review", "write", "fix", "call", "plan", "email", "update", "draft", "report",
+                                  "budget", "meeting", "notes", "deploy", "test", "release", "invoice", "design",
+                                  "sync", "backup", "docs", "quarterly", "client", "server", "car", "groceries"};
+    const size_t nwords = sizeof words / sizeof words[0];
+    const uint32_t today = date_to_day("2026-10-14");
+    std::uniform_int_distribution<int> pct(0, 99);
+    std::uniform_int_distribution<size_t> word(0, nwords - 1);
+    std::uniform_int_distribution<int> len(2, 6);
+    std::normal_distribution<double> offset(20.0, 45.0);
+    std::vector<Task> v;
+    v.reserve(n);
+    std::string title;
+    for (size_t i = 0; i < n; ++i) {
+        Task t;
+        t.id = static_cast<int>(i + 1);
+        t.done = pct(rng) < 25;
+        int p = pct(rng);
+        t.priority = p < 20 ? 'H' : p < 75 ? 'M' : 'L';
+        if (pct(rng) >= 35) {
+            double d = std::max(-365.0, std::min(730.0, offset(rng)));
+            t.due = static_cast<uint32_t>(static_cast<int>(today) + static_cast<int>(d));
+        }
+        title.clear();
+        for (int w = len(rng); w > 0; --w) {
+            if (!title.empty()) title += ' ';
+            title += words[word(rng)];
+        }
+        title += ' ';
+        title += std::to_string(i + 1);
+        t.title = arena.intern(title);
+        v.push_back(t);
+    }
+    return v;
+}
+
+// removes the store files (tasks.*) from the scratch directory
+static void clear_store() {
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(fs::current_path(), ec))
+        if (e.path().filename().string().rfind("tasks.", 0) == 0) fs::remove_all(e.path(), ec);
+}
+
+template <class Fn>
+static std::vector<double> time_reps(int reps, Fn&& fn) {
+    std::vector<double> ms;
+    for (int r = 0; r < reps; ++r) {
+        auto t0 = Clock::now();
+        fn();
+        ms.push_back(ms_since(t0));
+    }
+    return ms;
+}
+
+static void bench_size(size_t n, const Options& o) {
+    auto want = [&](const char* name) { return o.only.empty() || std::string(name).find(o.only) != std::string::npos; };
+    std::mt19937 rng(static_cast<unsigned>(n));
+    NullBuf nb;
+    std::ostream null_out(&nb);
+    clear_store();
+
+    TitleArena arena;
+    std::vector<Task> tasks = synth_tasks(n, arena, rng);
+
+    if (want("save_tasks/tsv")) report("save_tasks/tsv", n, time_reps(o.reps, [&]{ save_tasks(tasks); }), n);
+    else save_tasks(tasks);
+    if (want("load_tasks/tsv"))
+        report("load_tasks/tsv", n, time_reps(o.reps, [&]{ TaskList l = load_tasks(); (void)l; }), n);
+
+    // the structural scan alone, at each level this cpu runs
+    for (ScanLevel lv : {ScanLevel::Scalar, ScanLevel::Sse2, ScanLevel::Avx2, ScanLevel::Neon}) {
+        g_scan_level = lv;
+        const std::string name = std::string("scan/") + scan_level_name();
+        if (static_cast<int>(lv) > static_cast<int>(ScanLevel::Scalar) && name == "scan/scalar") continue;
+        if (!want(name.c_str())) continue;
+        with_file_view(data_path(), [&](std::string_view buf) {
+            report(name, n, time_reps(o.reps, [&]{
+                size_t lines = 0;
+                for_each_tsv_line(buf, [&](std::string_view, const uint32_t*, unsigned k) { lines += k; });
+                if (lines == 0) std::printf("(empty)\n");
+            }), n);
+        });
+    }
+    g_scan_level = ScanLevel::Auto;
+
+    TaskList loaded = load_tasks();
+    for (SortKey k : {SortKey::Due, SortKey::Priority, SortKey::Id}) {
+        static const char* names[] = {"sort/due", "sort/priority", "sort/id"};
+        const char* name = names[static_cast<int>(k)];
+        if (!want(name)) continue;
+        report(name, n, time_reps(o.reps, [&]{ auto e = sort_tasks(loaded.tasks, k); (void)e; }), n);
+    }
+    if (want("sort/pending-limit20"))
+        report("sort/pending-limit20", n, time_reps(o.reps, [&]{
+            auto e = sort_tasks(loaded.tasks, SortKey::Priority, ListFilter::Pending, 0, 20); (void)e;
+        }), n);
+    for (OutFormat f : {OutFormat::Table, OutFormat::Ndjson}) {
+        const char* name = f == OutFormat::Table ? "list_cmd/table" : "list_cmd/ndjson";
+        if (!want(name)) continue;
+        report(name, n, time_reps(o.reps, [&]{
+            list_cmd(loaded.tasks, ListFilter::All, SortKey::Due, 0, 0, f, null_out);
+        }), n);
+    }
+
+    // per-command latency through the same path as the CLI
+    auto run = [&](std::vector<std::string> args) { run_command(args, nullptr, null_out, null_out); };
+    auto per_op = [&](const char* name, auto&& make_args) {
+        if (!want(name)) return;
+        std::vector<double> ms;
+        for (int i = 0; i < o.ops; ++i) {
+            std::vector<std::string> args = make_args(i);
+            auto t0 = Clock::now();
+            run(args);
+            ms.push_back(ms_since(t0));
+        }
+        report(name, n, ms, 1);
+    };
+    std::uniform_int_distribution<size_t> pick(1, n);
+    run({"list", "--limit", "1"}); // builds the .idx once, outside the timings
+    per_op("cmd/done", [&](int) { return std::vector<std::string>{"done", std::to_string(pick(rng))}; });
+    per_op("cmd/rm", [&](int) { return std::vector<std::string>{"rm", std::to_string(pick(rng))}; });
+    per_op("cmd/add", [&](int) { return std::vector<std::string>{"add", "bench", "task", "-p", "H"}; });
+    per_op("cmd/list-cached", [&](int) { return std::vector<std::string>{"list", "--pending", "--sort=priority"}; });
+
+#if defined(TT_HAVE_POSIX_IO)
+    // whole-process latency of the tt binary: exec, startup, the command and
+    // exit, as a script calling tt sees it
+    auto startup = [&](const char* name, std::vector<std::string> args) {
+        if (o.tt.empty() || !want(name)) return;
+        args.insert(args.begin(), o.tt.string());
+        std::vector<char*> argv;
+        for (auto& a : args) argv.push_back(&a[0]);
+        argv.push_back(nullptr);
+        posix_spawn_file_actions_t io;
+        posix_spawn_file_actions_init(&io);
+        posix_spawn_file_actions_addopen(&io, 1, "/dev/null", O_WRONLY, 0);
+        std::vector<double> ms;
+        for (int i = 0; i < o.ops; ++i) {
+            auto t0 = Clock::now();
+            pid_t pid;
+            int status = 0;
+            if (posix_spawn(&pid, argv[0], &io, nullptr, argv.data(), environ) != 0) break;
+            ::waitpid(pid, &status, 0);
+            ms.push_back(ms_since(t0));
+        }
+        posix_spawn_file_actions_destroy(&io);
+        report(name, n, ms, 1);
+    };
+    startup("startup/help", {"help"});
+    startup("startup/add", {"add", "bench", "task", "-p", "H"});
+    startup("startup/list", {"list", "--pending", "--limit", "20"});
+#endif
+
+    // same bulk paths against tasks.bin
+    save_tasks(load_tasks().tasks);
+    run({"import"});
+    if (want("load_tasks/bin"))
+        report("load_tasks/bin", n, time_reps(o.reps, [&]{ TaskList l = load_tasks(); (void)l; }), n);
+    if (want("save_tasks/bin"))
+        report("save_tasks/bin", n, time_reps(o.reps, [&]{ save_tasks(loaded.tasks); }), n);
+}
+
+static bool parse_options(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a.rfind("--sizes=", 0) == 0) {
+            o.sizes.clear();
+            std::string_view rest = std::string_view(a).substr(8);
+            while (!rest.empty()) {
+                size_t comma = rest.find(',');
+                std::string_view one = rest.substr(0, comma);
+                size_t v = 0;
+                if (std::from_chars(one.data(), one.data() + one.size(), v).ec != std::errc() || v == 0) return false;
+                o.sizes.push_back(v);
+                rest.remove_prefix(comma == std::string_view::npos ? rest.size() : comma + 1);
+            }
+        } else if (a.rfind("--reps=", 0) == 0) {
+            o.reps = std::max(1, parse_int(a.substr(7)));
+        } else if (a.rfind("--ops=", 0) == 0) {
+            o.ops = std::max(1, parse_int(a.substr(6)));
+        } else if (a.rfind("--only=", 0) == 0) {
+            o.only = a.substr(7);
+        } else if (a.rfind("--dir=", 0) == 0) {
+            o.dir = a.substr(6);
+        } else if (a.rfind("--tt=", 0) == 0) {
+            o.tt = a.substr(5);
+        } else {
+            return false;
+        }
+    }
+    return !o.sizes.empty();
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!parse_options(argc, argv, o)) {
+        std::cerr << "Usage: tt_bench [--sizes=1000,10000,...] [--reps=N] [--ops=N] [--only=NAME] [--dir=PATH] [--tt=PATH]\n";
+        return 1;
+    }
+    std::error_code ec;
+    // startup/* runs the tt built beside tt_bench unless --tt names another
+    if (o.tt.empty()) {
+        fs::path beside = fs::absolute(argv[0], ec).parent_path() / "tt";
+        if (fs::exists(beside, ec)) o.tt = beside;
+    } else {
+        o.tt = fs::absolute(o.tt, ec);
+    }
+    fs::path dir = o.dir.empty() ? fs::temp_directory_path(ec) / "tt_bench" : o.dir;
+    fs::create_directories(dir, ec);
+    if (ec) { std::cerr << "Cannot create " << dir.string() << "\n"; return 1; }
+    fs::path home = fs::current_path();
+    fs::current_path(dir);
+
+    std::printf("%-22s %10s %8s %12s %12s %14s\n", "benchmark", "tasks", "samples", "median ms", "p99 ms", "items/s");
+    for (size_t n : o.sizes) bench_size(n, o);
+
+    clear_store();
+    fs::current_path(home);
+    if (o.dir.empty()) fs::remove(dir, ec);
+    return 0;
+}
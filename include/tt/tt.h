@@ -0,0 +1,123 @@
+// libtt: the task store behind the tt command, for use in-process.
+//
+//   auto store = tt::TaskStore::open("/path/to/dir");
+//   int id = store->add("Write README", 'H', tt::date_to_day("2025-08-31"));
+//   tt::Query q;
+//   q.filter = tt::ListFilter::Pending;
+//   for (const tt::Task& t : store->query(q)) ...
+//
+// a store directory holds tasks.tsv (or tasks.bin) plus its journal, lock
+// and index files, exactly as the tt command leaves them, so the library and
+// the command can share one store. other lists in the same directory use
+// their own name in place of "tasks" (tt -l ops: ops.tsv, ...). a TaskStore
+// may be used by one thread at a time; separate TaskStores may be used from
+// separate threads.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tt {
+
+struct Task {
+    int id{};
+    bool done{false};
+    char priority{'M'};                // H, M, L
+    uint32_t due{0};                   // day number (date_to_day), 0 = none
+    std::string_view title;            // no newlines; '|' not allowed; in a TitleArena
+};
+
+enum class ListFilter { All, Pending, Done };
+enum class SortKey { Due, Priority, Id };
+
+struct Query {
+    ListFilter filter{ListFilter::All};
+    SortKey sort{SortKey::Due};
+    size_t offset{0};
+    size_t limit{0};     // 0 = no limit
+    uint32_t due_from{0}; // keep tasks due in [due_from, due_to); 0 = unbounded
+    uint32_t due_to{0};
+};
+
+// day numbers for YYYY-MM-DD dates; 0 for anything that is not a real date
+uint32_t date_to_day(std::string_view d);
+std::string day_to_date(uint32_t day);
+
+// an open store, loaded once and kept in memory. changes are queued and
+// written (journal append, or snapshot rewrite) by flush(), which also runs
+// on destruction. flush takes the store lock and merges with whatever other
+// processes wrote in the meantime, renumbering adds if their id was taken.
+class TaskStore {
+public:
+    // nullptr if dir is not a directory or the store can't be read; the
+    // reason goes to *error when given
+    static std::unique_ptr<TaskStore> open(const std::filesystem::path& dir, std::string* error = nullptr);
+    // the named list in dir; names are letters, digits, '-', '_' and '.'
+    static std::unique_ptr<TaskStore> open(const std::filesystem::path& dir, std::string_view list,
+                                           std::string* error = nullptr);
+    ~TaskStore();
+    TaskStore(const TaskStore&) = delete;
+    TaskStore& operator=(const TaskStore&) = delete;
+
+    // the new id, or -1 for an empty title or a priority other than H/M/L
+    int add(std::string_view title, char priority = 'M', uint32_t due = 0);
+    bool mark_done(int id);
+    bool remove(int id);
+
+    // the sorted, filtered page q describes. titles stay valid until
+    // refresh() or the store is closed
+    std::vector<Task> query(const Query& q = Query());
+    // the same rows, passed to fn in order without building a vector
+    void for_each(const Query& q, const std::function<void(const Task&)>& fn);
+    size_t size();
+
+    // false if the queued changes could not be written; they stay queued
+    bool flush();
+    // reloads if another process changed the store and nothing is queued
+    void refresh();
+
+private:
+    struct Impl;
+    explicit TaskStore(std::unique_ptr<Impl> impl);
+    std::unique_ptr<Impl> impl_;
+};
+
+// open stores shared across a process that works on many lists. the
+// capacity most recently used stay loaded; beyond that the least recently
+// used is flushed and let go, and loaded again when next asked for. a store
+// handed out stays valid while held, and get returns that same store until
+// it is released. one thread at a time, like TaskStore.
+class StorePool {
+public:
+    explicit StorePool(size_t capacity = 64);
+    ~StorePool();
+    StorePool(const StorePool&) = delete;
+    StorePool& operator=(const StorePool&) = delete;
+
+    // nullptr, with the reason in *error when given, as TaskStore::open
+    std::shared_ptr<TaskStore> get(const std::filesystem::path& dir, std::string_view list = "tasks",
+                                   std::string* error = nullptr);
+    // stores currently loaded by the pool
+    size_t size() const;
+    // flushes every loaded store; false if any could not be written
+    bool flush();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// runs one tt command line (without the program name) against the store in
+// dir, writing what the command would print to out and err. returns the
+// command's exit code.
+int run(const std::filesystem::path& dir, const std::vector<std::string>& args, std::ostream& out,
+        std::ostream& err);
+
+} // namespace tt
@@ -0,0 +1,229 @@
+// the archive: cold storage for completed tasks, compressed and append-only
+#include "tt_internal.h"
+
+namespace tt {
+
+// tasks.archive is a run of blocks, each written once and never touched
+// again:
+//   header  "TTA1", u32 raw size, u32 packed size, u32 task count,
+//           i32 highest id, u32 FNV-1a of the raw bytes
+//   packed  the block's task lines, as in tasks.tsv, compressed with the
+//           LZ codec below
+// an append torn by a crash leaves a short final block, which readers stop
+// at and the next append cuts off first.
+fs::path archive_path() {
+    return store_dir() / (store_name() + ".archive");
+}
+
+int g_archive_after = -1;
+
+static const char ARC_MAGIC[4] = {'T', 'T', 'A', '1'};
+static const size_t ARC_HEADER = 24;
+static const size_t ARC_BLOCK = 1 << 20; // raw bytes per block
+
+static uint32_t fnv1a(std::string_view s) {
+    uint32_t h = 2166136261u;
+    for (char c : s) h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+    return h;
+}
+
+// LZ codec, close to the LZ4 block format: a sequence is a token byte (high
+// nibble literal count, low nibble match length - 4, 15 meaning more length
+// bytes follow), the literals, and a 2-byte offset back into the output.
+// the last sequence is literals only. matches are found through a hash of
+// the next 4 bytes, keeping the latest position per bucket.
+static const int LZ_HASH_BITS = 16;
+static const size_t LZ_MIN_MATCH = 4;
+static const size_t LZ_MAX_OFFSET = 0xffff;
+
+static uint32_t read32(const char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+static void put_length(std::string& out, size_t n) {
+    for (; n >= 255; n -= 255) out += '\xff';
+    out += static_cast<char>(n);
+}
+
+static std::string lz_compress(std::string_view in) {
+    std::string out;
+    out.reserve(in.size() / 2 + 16);
+    std::vector<uint32_t> table(size_t(1) << LZ_HASH_BITS, 0); // position + 1
+    const size_t n = in.size();
+    size_t anchor = 0, i = 0;
+    auto literals = [&](size_t end, unsigned low) {
+        size_t lit = end - anchor;
+        out += static_cast<char>((std::min<size_t>(lit, 15) << 4) | low);
+        if (lit >= 15) put_length(out, lit - 15);
+        out.append(in.data() + anchor, lit);
+    };
+    while (i + LZ_MIN_MATCH <= n) {
+        const uint32_t v = read32(in.data() + i);
+        const uint32_t h = (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+        const size_t cand = table[h];
+        table[h] = static_cast<uint32_t>(i + 1);
+        if (!cand || i - (cand - 1) > LZ_MAX_OFFSET || read32(in.data() + cand - 1) != v) {
+            ++i;
+            continue;
+        }
+        const size_t from = cand - 1;
+        size_t len = LZ_MIN_MATCH;
+        while (i + len < n && in[from + len] == in[i + len]) ++len;
+        const size_t m = len - LZ_MIN_MATCH;
+        literals(i, static_cast<unsigned>(std::min<size_t>(m, 15)));
+        const size_t off = i - from;
+        out += static_cast<char>(off & 0xff);
+        out += static_cast<char>(off >> 8);
+        if (m >= 15) put_length(out, m - 15);
+        i += len;
+        anchor = i;
+    }
+    literals(n, 0);
+    return out;
+}
+
+// false for anything that does not decode to exactly raw bytes
+static bool lz_decompress(std::string_view in, size_t raw, std::string& out) {
+    out.clear();
+    out.reserve(raw);
+    size_t i = 0;
+    auto length = [&](size_t& n) {
+        unsigned char b;
+        do {
+            if (i >= in.size()) return false;
+            b = static_cast<unsigned char>(in[i++]);
+            n += b;
+        } while (b == 255);
+        return true;
+    };
+    while (i < in.size()) {
+        const unsigned char token = static_cast<unsigned char>(in[i++]);
+        size_t lit = token >> 4;
+        if (lit == 15 && !length(lit)) return false;
+        if (lit > in.size() - i || out.size() + lit > raw) return false;
+        out.append(in.data() + i, lit);
+        i += lit;
+        if (i == in.size()) break;
+        if (in.size() - i < 2) return false;
+        const size_t off = static_cast<unsigned char>(in[i]) | static_cast<size_t>(static_cast<unsigned char>(in[i + 1])) << 8;
+        i += 2;
+        size_t len = token & 15;
+        if (len == 15 && !length(len)) return false;
+        len += LZ_MIN_MATCH;
+        if (!off || off > out.size() || out.size() + len > raw) return false;
+        // byte by byte, since a match may overlap the bytes it produces
+        size_t from = out.size() - off;
+        for (size_t k = 0; k < len; ++k) out += out[from + k];
+    }
+    return out.size() == raw;
+}
+
+struct ArchiveBlock {
+    uint32_t raw, packed, count;
+    int32_t max_id;
+    uint32_t sum;
+};
+
+static bool read_block_header(std::string_view buf, size_t at, ArchiveBlock& b) {
+    if (buf.size() - at < ARC_HEADER || std::memcmp(buf.data() + at, ARC_MAGIC, 4) != 0) return false;
+    const char* p = buf.data() + at;
+    b.raw = get_u32(p + 4);
+    b.packed = get_u32(p + 8);
+    b.count = get_u32(p + 12);
+    std::memcpy(&b.max_id, p + 16, 4);
+    b.sum = get_u32(p + 20);
+    return buf.size() - at - ARC_HEADER >= b.packed;
+}
+
+// calls fn(header, offset of the packed bytes) for each complete block, and
+// returns where the last one ends
+template <class Fn>
+static size_t for_each_block(std::string_view buf, Fn&& fn) {
+    size_t at = 0;
+    ArchiveBlock b;
+    while (at < buf.size() && read_block_header(buf, at, b)) {
+        fn(b, at + ARC_HEADER);
+        at += ARC_HEADER + b.packed;
+    }
+    return at;
+}
+
+static void put_block(std::string& out, std::string_view raw, uint32_t count, int32_t max_id) {
+    std::string packed = lz_compress(raw);
+    out.append(ARC_MAGIC, 4);
+    put_u32(out, static_cast<uint32_t>(raw.size()));
+    put_u32(out, static_cast<uint32_t>(packed.size()));
+    put_u32(out, count);
+    out.append(reinterpret_cast<const char*>(&max_id), 4);
+    put_u32(out, fnv1a(raw));
+    out += packed;
+}
+
+// the tasks are appended before the store drops them, so an interrupted
+// save leaves a task in both rather than in neither; readers skip the copy
+bool archive_tasks(const std::vector<Task>& v, uint32_t before, std::vector<Task>& rest, size_t& moved) {
+    rest.clear();
+    moved = 0;
+    std::string blocks, raw;
+    uint32_t count = 0;
+    int32_t max_id = 0;
+    for (const auto& t : v) {
+        if (!t.done || (before && (!t.due || t.due >= before))) {
+            rest.push_back(t);
+            continue;
+        }
+        std::ostringstream line;
+        write_task(line, t);
+        raw += line.str();
+        ++count;
+        max_id = std::max(max_id, t.id);
+        if (raw.size() >= ARC_BLOCK) {
+            put_block(blocks, raw, count, max_id);
+            moved += count;
+            raw.clear();
+            count = 0;
+            max_id = 0;
+        }
+    }
+    if (count) put_block(blocks, raw, count, max_id);
+    moved += count;
+    if (blocks.empty()) return true;
+    const fs::path p = archive_path();
+    std::error_code ec;
+    size_t end = 0;
+    if (with_file_view(p, [&](std::string_view buf) { end = for_each_block(buf, [](const ArchiveBlock&, size_t) {}); }) &&
+        end != fs::file_size(p, ec))
+        fs::resize_file(p, end, ec);
+    if (ec) return false;
+    return append_file(p, blocks);
+}
+
+void scan_archive(TaskList& l, const std::function<bool(const Task&)>& match) {
+    std::unordered_set<int> seen;
+    seen.reserve(l.tasks.size());
+    for (const auto& t : l.tasks) seen.insert(t.id);
+    std::string raw;
+    with_file_view(archive_path(), [&](std::string_view buf) {
+        for_each_block(buf, [&](const ArchiveBlock& b, size_t at) {
+            if (!lz_decompress(buf.substr(at, b.packed), b.raw, raw) || fnv1a(raw) != b.sum) return;
+            split_lines(raw, [&](std::string_view line) {
+                Task t;
+                if (is_blank(line) || !parse_task(line, t) || !match(t) || !seen.insert(t.id).second) return;
+                t.title = l.titles.intern(t.title);
+                l.tasks.push_back(t);
+            });
+        });
+    });
+}
+
+int32_t archive_max_id() {
+    int32_t max_id = 0;
+    with_file_view(archive_path(), [&](std::string_view buf) {
+        for_each_block(buf, [&](const ArchiveBlock& b, size_t) { max_id = std::max(max_id, b.max_id); });
+    });
+    return max_id;
+}
+
+} // namespace tt
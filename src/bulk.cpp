@@ -0,0 +1,373 @@
+// bulk transfer: tt export streams the store out in any output format, and
+// tt import --format=csv|ndjson adds rows from another tracker as new tasks
+#include "tt_internal.h"
+
+namespace tt {
+
+// export: the journal is summarised first (it is small next to the
+// snapshot), then the snapshot is streamed straight from its mapping with
+// the journal applied on the fly, so no task vector is ever built. rows come
+// out in the order load_tasks would return them.
+JournalOverlay read_overlay() {
+    JournalOverlay j;
+    for_each_record([&](std::string_view line) {
+        if (line.size() < 3 || line[1] != SEP) return;
+        std::string_view rest = line.substr(2);
+        if (line[0] == '+') {
+            Task t;
+            if (!parse_task(rest, t, &j.titles)) return;
+            auto it = j.add_pos.find(t.id);
+            if (it != j.add_pos.end() && j.add_live[it->second]) {
+                j.adds[it->second] = t;
+                return;
+            }
+            j.add_pos[t.id] = j.adds.size();
+            j.add_in_place.push_back(it == j.add_pos.end() && !j.dead.count(t.id));
+            j.adds.push_back(t);
+            j.add_live.push_back(1);
+        } else if (line[0] == 'x' || line[0] == '-') {
+            int id = 0;
+            if (!parse_journal_id(rest, id)) return;
+            auto it = j.add_pos.find(id);
+            if (it != j.add_pos.end()) {
+                size_t i = it->second;
+                if (!j.add_live[i]) return;
+                if (line[0] == 'x') {
+                    j.adds[i].done = true;
+                } else {
+                    j.add_live[i] = 0;
+                    if (j.add_in_place[i]) j.dead.insert(id);
+                }
+            } else if (!j.dead.count(id)) {
+                (line[0] == 'x' ? j.done : j.dead).insert(id);
+            }
+        }
+    });
+    return j;
+}
+
+void for_each_live_task(ListFilter keep, const std::function<void(const Task&)>& fn) {
+    JournalOverlay j = read_overlay();
+    std::vector<char> emitted(j.adds.size(), 0);
+    const bool binary = use_binary();
+    auto put = [&](const Task& t) { if (keep_task(keep, t.done)) fn(t); };
+    auto emit = [&](const Task& t, uint64_t) {
+        if (j.dead.count(t.id)) return;
+        auto it = j.add_pos.find(t.id);
+        if (it != j.add_pos.end() && j.add_in_place[it->second]) {
+            emitted[it->second] = 1;
+            if (j.add_live[it->second]) put(j.adds[it->second]);
+            return;
+        }
+        if (j.done.count(t.id)) {
+            Task d = t;
+            d.done = true;
+            put(d);
+        } else {
+            put(t);
+        }
+    };
+    if (keep != ListFilter::Pending && sharded()) {
+        // the shard comes first; a task left in both files by an interrupted
+        // save is the snapshot's
+        std::vector<int> ids;
+        with_file_view(store_path(), [&](std::string_view buf) {
+            for_each_snapshot_id(buf, binary, [&](int id) { ids.push_back(id); });
+        });
+        std::sort(ids.begin(), ids.end());
+        with_file_view(shard_path(binary), [&](std::string_view buf) {
+            for_each_snapshot_task(buf, binary, [&](const Task& t, uint64_t off) {
+                if (!std::binary_search(ids.begin(), ids.end(), t.id)) emit(t, off);
+            });
+        });
+    }
+    with_file_view(store_path(), [&](std::string_view buf) { for_each_snapshot_task(buf, binary, emit); });
+    for (size_t i = 0; i < j.adds.size(); ++i)
+        if (j.add_live[i] && !emitted[i]) put(j.adds[i]);
+}
+
+void export_tasks(TaskWriter& w) {
+    TT_PHASE(Phase::Output);
+    for_each_live_task(ListFilter::All, [&](const Task& t) { w.write(t); });
+}
+
+// import: rows are gathered IMPORT_BATCH at a time into per-column arrays,
+// checked a column per plain loop (priorities, then dates, then titles), and
+// only then added to the loaded store. the whole store and every imported
+// row stay in memory until the end: nothing is written unless every row is
+// valid, and then the store is saved once with the new tasks numbered after
+// the highest id ever assigned.
+static const size_t IMPORT_BATCH = 4096;
+
+struct ImportBatch {
+    std::vector<size_t> line;        // where the row started, for errors
+    std::vector<char> prio;          // as given; 0 when the column was empty
+    std::vector<char> done;
+    std::string dates;               // 10 bytes per row, all '\0' when undated
+    std::string heap;                // titles
+    std::vector<std::pair<uint32_t, uint32_t>> title;
+    std::vector<uint32_t> due;
+    std::vector<char> bad;
+
+    size_t size() const { return line.size(); }
+
+    void add(size_t at, std::string_view t, std::string_view p, std::string_view d, bool is_done) {
+        line.push_back(at);
+        prio.push_back(p.empty() ? 0 : p.size() == 1 ? p[0] : '?');
+        done.push_back(is_done);
+        if (d.empty() || d == "-") dates.append(10, '\0');
+        else if (d.size() == 10) dates.append(d);
+        else dates.append(10, '?');
+        title.emplace_back(static_cast<uint32_t>(heap.size()), static_cast<uint32_t>(t.size()));
+        heap.append(t);
+    }
+
+    void clear() {
+        line.clear(); prio.clear(); done.clear(); dates.clear(); heap.clear(); title.clear();
+    }
+};
+
+// the first row of b that fails validation, or npos. fills b.due and
+// upper-cases b.prio
+static size_t validate_batch(ImportBatch& b, std::string& error) {
+    const size_t n = b.size();
+    b.due.assign(n, 0);
+    b.bad.assign(n, 0);
+    for (size_t i = 0; i < n; ++i) {
+        char p = b.prio[i] ? static_cast<char>(b.prio[i] & ~0x20) : 'M';
+        b.prio[i] = p;
+        b.bad[i] = (p != 'H') & (p != 'M') & (p != 'L');
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const char* d = b.dates.data() + i * 10;
+        if (!d[0]) continue;
+        b.due[i] = date_to_day(std::string_view(d, 10));
+        b.bad[i] |= (b.due[i] == 0) << 1;
+    }
+    for (size_t i = 0; i < n; ++i) b.bad[i] |= (b.title[i].second == 0) << 2;
+    auto it = std::find_if(b.bad.begin(), b.bad.end(), [](char f) { return f != 0; });
+    if (it == b.bad.end()) return std::string_view::npos;
+    size_t i = static_cast<size_t>(it - b.bad.begin());
+    error = "line " + std::to_string(b.line[i]) + ": ";
+    if (*it & 1) error += "invalid priority. Use H/M/L.";
+    else if (*it & 2) error += "invalid date, expected YYYY-MM-DD.";
+    else error += "title required.";
+    return i;
+}
+
+static void keep_batch(const ImportBatch& b, TaskList& l, int32_t& max_id, const IdSpace& ids) {
+    for (size_t i = 0; i < b.size(); ++i) {
+        Task t;
+        t.id = max_id = next_id(max_id, ids);
+        t.done = b.done[i];
+        t.priority = b.prio[i];
+        t.due = b.due[i];
+        t.title = l.titles.intern(std::string_view(b.heap).substr(b.title[i].first, b.title[i].second));
+        l.tasks.push_back(t);
+    }
+}
+
+// titles stay on one line and lose surrounding blanks
+static std::string clean_title(std::string s) {
+    for (char& c : s) if (c == '\n' || c == '\r' || c == '\t') c = ' ';
+    return trim(s);
+}
+
+static bool truthy(std::string_view s) {
+    return s == "1" || s == "true" || s == "x" || s == "yes";
+}
+
+// one CSV record (RFC 4180): fields split on commas, "..." quotes with ""
+// for a literal quote, and a quoted field may run over several lines.
+// false at the end of input.
+static bool read_csv_record(std::istream& in, std::vector<std::string>& f, size_t& line) {
+    std::string s;
+    if (!std::getline(in, s)) return false;
+    ++line;
+    f.clear();
+    std::string cur;
+    bool quoted = false;
+    for (size_t i = 0;; ++i) {
+        if (i == s.size()) {
+            std::string next;
+            if (!quoted || !std::getline(in, next)) break;
+            ++line;
+            cur += '\n';
+            s = std::move(next);
+            i = static_cast<size_t>(-1);
+            continue;
+        }
+        char c = s[i];
+        if (quoted) {
+            if (c != '"') cur += c;
+            else if (i + 1 < s.size() && s[i + 1] == '"') { cur += '"'; ++i; }
+            else quoted = false;
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            f.push_back(std::move(cur));
+            cur.clear();
+        } else if (c != '\r' || i + 1 != s.size()) {
+            cur += c;
+        }
+    }
+    f.push_back(std::move(cur));
+    return true;
+}
+
+static void put_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// a JSON string starting at s[i] (the opening quote); i ends past the close
+static bool json_string(std::string_view s, size_t& i, std::string& out) {
+    out.clear();
+    for (++i; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '"') { ++i; return true; }
+        if (c != '\\') { out += c; continue; }
+        if (++i == s.size()) return false;
+        switch (s[i]) {
+            case '"': case '\\': case '/': out += s[i]; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                auto hex4 = [&](size_t at, uint32_t& v) {
+                    if (at + 4 > s.size()) return false;
+                    return std::from_chars(s.data() + at, s.data() + at + 4, v, 16).ptr == s.data() + at + 4;
+                };
+                uint32_t cp = 0;
+                if (!hex4(i + 1, cp)) return false;
+                i += 4;
+                uint32_t lo = 0;
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 2 < s.size() && s[i + 1] == '\\' && s[i + 2] == 'u' &&
+                    hex4(i + 3, lo) && lo >= 0xDC00 && lo < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    i += 6;
+                }
+                put_utf8(out, cp);
+                break;
+            }
+            default: return false;
+        }
+    }
+    return false;
+}
+
+// calls fn(key, value) for each member of a flat JSON object. strings are
+// unescaped, null is empty and numbers and booleans keep their text; nested
+// objects and arrays are rejected.
+template <class Fn>
+static bool for_each_json_member(std::string_view s, Fn&& fn) {
+    size_t i = 0;
+    auto ws = [&] { while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r')) ++i; };
+    ws();
+    if (i == s.size() || s[i++] != '{') return false;
+    std::string key, val;
+    ws();
+    if (i < s.size() && s[i] == '}') return true;
+    while (true) {
+        ws();
+        if (i == s.size() || s[i] != '"' || !json_string(s, i, key)) return false;
+        ws();
+        if (i == s.size() || s[i++] != ':') return false;
+        ws();
+        if (i == s.size()) return false;
+        if (s[i] == '"') {
+            if (!json_string(s, i, val)) return false;
+        } else {
+            size_t b = i;
+            while (i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ' ' && s[i] != '\t') ++i;
+            val.assign(s.substr(b, i - b));
+            if (val == "null") val.clear();
+            else if (val.empty() || val[0] == '{' || val[0] == '[') return false;
+        }
+        fn(key, val);
+        ws();
+        if (i == s.size()) return false;
+        if (s[i] == '}') return true;
+        if (s[i++] != ',') return false;
+    }
+}
+
+bool import_tasks(std::istream& in, bool csv, size_t& added, std::string& error) {
+    TaskList l = load_tasks();
+    IndexHeader h;
+    int32_t max_id = open_index(h) ? h.max_id : 0;
+    for (const auto& t : l.tasks) max_id = std::max(max_id, t.id);
+    const size_t before = l.tasks.size();
+    const IdSpace ids = id_space();
+
+    ImportBatch b;
+    auto take = [&]() {
+        if (validate_batch(b, error) != std::string_view::npos) return false;
+        keep_batch(b, l, max_id, ids);
+        b.clear();
+        return true;
+    };
+    size_t line = 0;
+    if (csv) {
+        std::vector<std::string> f;
+        int col_title = -1, col_prio = -1, col_due = -1, col_done = -1;
+        if (read_csv_record(in, f, line)) {
+            for (size_t c = 0; c < f.size(); ++c) {
+                std::string name = trim(f[c]);
+                for (char& ch : name) ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+                if (name == "title") col_title = static_cast<int>(c);
+                else if (name == "priority" || name == "prio") col_prio = static_cast<int>(c);
+                else if (name == "due") col_due = static_cast<int>(c);
+                else if (name == "done") col_done = static_cast<int>(c);
+            }
+        }
+        if (col_title < 0) { error = "CSV input needs a header row with a title column."; return false; }
+        auto field = [&](int c) { return c >= 0 && static_cast<size_t>(c) < f.size() ? trim(f[c]) : std::string(); };
+        size_t at = line + 1;
+        while (read_csv_record(in, f, line)) {
+            if (f.size() == 1 && is_blank(f[0])) { at = line + 1; continue; }
+            b.add(at, clean_title(field(col_title)), field(col_prio), field(col_due), truthy(field(col_done)));
+            at = line + 1;
+            if (b.size() == IMPORT_BATCH && !take()) return false;
+        }
+    } else {
+        std::string s, title, prio, due;
+        while (std::getline(in, s)) {
+            ++line;
+            if (is_blank(s)) continue;
+            title.clear(); prio.clear(); due.clear();
+            bool done = false;
+            bool ok = for_each_json_member(s, [&](const std::string& k, const std::string& v) {
+                if (k == "title") title = v;
+                else if (k == "priority") prio = trim(v);
+                else if (k == "due") due = trim(v);
+                else if (k == "done") done = truthy(v);
+            });
+            if (!ok) { error = "line " + std::to_string(line) + ": expected one JSON object per line."; return false; }
+            b.add(line, clean_title(title), prio, due, done);
+            if (b.size() == IMPORT_BATCH && !take()) return false;
+        }
+    }
+    if (b.size() && !take()) return false;
+    added = l.tasks.size() - before;
+    if (!added) return true;
+    if (!save_tasks(l.tasks)) { error = "Error: cannot write tasks."; return false; }
+    return true;
+}
+
+} // namespace tt
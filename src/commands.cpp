@@ -0,0 +1,686 @@
+// the tt commands, shared by the CLI, batch, serve and tt::run
+#include "tt_internal.h"
+
+namespace tt {
+
+void help(std::ostream& out) {
+    out << "Task Tracker (tt)\n\n"
+        << "Usage:\n"
+        << "  tt [--sync=none|close|always] [--lock-free] [--threads=N] [--stats[=json]]\n"
+        << "     [--archive-after=DAYS] [--file=PATH] [-l LIST] <command> ...\n"
+        << "  tt add <title words...> [-p H|M|L] [-d YYYY-MM-DD]\n"
+        << "  tt list [--all|--pending|--done] [--sort=due|priority|id] [--offset N] [--limit N]\n"
+        << "          [--due-after=YYYY-MM-DD] [--due-before=YYYY-MM-DD] [--format=table|tsv|json|ndjson|csv]\n"
+        << "          [--priority=H,M,L] [--ids=1-50,72] [--match=words] [--no-cache] [--include-archive]\n"
+        << "          [--mem-limit=SIZE[K|M|G]]\n"
+        << "  tt find [--substr] <words...> [--sort=due|priority|id] [--limit N] [--format=...]\n"
+        << "  tt done <id> | --where <list conditions...>\n"
+        << "  tt rm <id> | --where <list conditions...>\n"
+        << "  tt clear [--done|--all]\n"
+        << "  tt compact\n"
+        << "  tt shard [--off]\n"
+        << "  tt archive [--older-than=DAYS]\n"
+        << "  tt import [file.tsv]\n"
+        << "  tt import --format=csv|ndjson <file|->\n"
+        << "  tt export [--format=tsv|csv|json|ndjson] [file|-]\n"
+        << "  tt batch [file|-]\n"
+        << "  tt serve [--socket=PATH] [--flush-ms=N] [--max-open=N]\n"
+        << "  tt watch [--initial] [--poll-ms=N]\n"
+        << "  tt sync init <node> [--nodes=N] | status\n"
+        << "  tt sync pull|push <peer store file> | --cmd=COMMAND\n"
+        << "  tt help\n\n"
+        << "Notes:\n"
+        << "  - Default 'tt list' now shows ALL tasks. Completed ones display as [x].\n"
+        << "  - Use --pending to show only pending, or --done to show only completed.\n"
+        << "  - --offset/--limit page through the sorted, filtered rows (--limit 0 = no limit).\n"
+        << "  - add/done/rm append to tasks.tsv.log; 'tt compact' folds it into tasks.tsv.\n"
+        << "  - 'tt import' converts to the binary tasks.bin, which is used whenever present,\n"
+        << "    and removes tasks.tsv and its journal and shard. 'tt import other.tsv' replaces\n"
+        << "    the tasks with that file's and leaves any tasks.tsv files unread but in place.\n"
+        << "  - 'tt shard' keeps completed tasks in tasks.done.tsv (or .bin) from then on, so\n"
+        << "    --pending listings, add and 'clear --done' never read them; --off merges back.\n"
+        << "  - 'tt archive' moves completed tasks (--older-than: due more than DAYS ago) into\n"
+        << "    the compressed, append-only tasks.archive; --archive-after=DAYS (or\n"
+        << "    TT_ARCHIVE_AFTER) does so on every rewrite. list --include-archive reads it back.\n"
+        << "  - 'tt import --format=csv|ndjson' adds the rows as new tasks (CSV needs a header\n"
+        << "    naming title and optionally priority, due, done) and saves once.\n"
+        << "  - A sidecar .idx maps ids to records; it is rebuilt automatically when stale.\n"
+        << "  - --due-after/--due-before keep dated tasks strictly inside the range, via a .due index.\n"
+        << "  - Plain listings are cached per filter/sort/format in <store>.views/ until the store\n"
+        << "    changes; --no-cache bypasses it.\n"
+        << "  - --sort=id listings stream from the store files without loading them; other\n"
+        << "    sorts over stores larger than --mem-limit spill sorted runs to disk and merge.\n"
+        << "  - done/rm --where take list's conditions (--pending, --priority, --ids, --due-before,\n"
+        << "    --due-after, --match), so 'tt list' with the same conditions previews them.\n"
+        << "  - 'tt find' matches every word (word* for prefixes) via a .fts index; --substr\n"
+        << "    scans for the exact text instead.\n"
+        << "  - 'tt batch' runs one command per line (stdin by default) and saves once.\n"
+        << "  - 'tt serve' keeps the store in memory; set TT_SOCKET to send commands to it.\n"
+        << "    import, shard, archive, batch, watch and sync still run in the calling process.\n"
+        << "    Commands for other lists (-l, --file) are served too, with the --max-open most\n"
+        << "    recently used lists kept loaded.\n"
+        << "  - 'tt watch' prints an NDJSON event per added, completed or removed task as other\n"
+        << "    commands change the store (--initial: every current task first, as added).\n"
+        << "  - 'tt sync' replicates a list between hosts by shipping only the changes a peer\n"
+        << "    lacks. Each copy is a node (tt sync init N, node numbers 0..N-1 of --nodes,\n"
+        << "    default 100) and then takes only ids ending in its number mod --nodes, so\n"
+        << "    concurrent adds never collide. The peer is a store file on a shared path or\n"
+        << "    --cmd=COMMAND running tt there, e.g. --cmd='ssh host tt --file=/srv/tasks.tsv'.\n"
+        << "  - Snapshots are replaced atomically; --sync (or TT_SYNC) adds fsync: 'close' once\n"
+        << "    per command or batch/serve flush, 'always' after every batch/serve command.\n"
+        << "  - Writers lock tasks.tsv.lock; --lock-free (or TT_LOCK_FREE=1) lets list/export\n"
+        << "    read the last committed state instead of waiting for a writer.\n"
+        << "  - --stats (or TT_STATS=1|json) prints per-phase times and counters to stderr.\n"
+        << "  - Large stores load and sort on --threads (or TT_THREADS) workers; 0 = all cores.\n\n"
+        << "Data file: tasks.tsv (in current directory); --file=PATH (or TT_FILE) names another,\n"
+        << "and -l LIST (--list=LIST, TT_LIST) uses LIST.tsv beside it. Each list has its own\n"
+        << "journal, index, shard and archive.\n";
+}
+
+// the whole of s as a decimal int; -1 for anything else, out of range
+// included
+int parse_int(const std::string& s) {
+    int v = 0;
+    auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size() ? v : -1;
+}
+
+// a byte count with an optional K, M or G suffix; 0 if malformed
+static size_t parse_size(const std::string& s) {
+    size_t n = 0;
+    auto r = std::from_chars(s.data(), s.data() + s.size(), n);
+    if (r.ec != std::errc()) return 0;
+    std::string_view unit(r.ptr, static_cast<size_t>(s.data() + s.size() - r.ptr));
+    if (unit.empty()) return n;
+    if (unit.size() != 1) return 0;
+    switch (std::toupper(static_cast<unsigned char>(unit[0]))) {
+        case 'K': return n << 10;
+        case 'M': return n << 20;
+        case 'G': return n << 30;
+        default: return 0;
+    }
+}
+
+bool split_args(const std::string& line, std::vector<std::string>& out) {
+    std::string cur;
+    bool have = false;
+    char quote = 0;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quote == '\'') {
+            if (c == '\'') quote = 0; else cur += c;
+        } else if (c == '\\' && i + 1 < line.size()) {
+            cur += line[++i]; have = true;
+        } else if (quote == '"') {
+            if (c == '"') quote = 0; else cur += c;
+        } else if (c == '\'' || c == '"') {
+            quote = c; have = true;
+        } else if (c == ' ' || c == '\t' || c == '\r') {
+            if (have) { out.push_back(cur); cur.clear(); have = false; }
+        } else {
+            cur += c; have = true;
+        }
+    }
+    if (have) out.push_back(cur);
+    return quote == 0;
+}
+
+// the tasks f selects. a due range is looked up in the .due index, which
+// may have to be rebuilt under the writer lock; false if that lock can't be
+// had. the caller holds lock shared.
+static bool select_tasks(const TaskFilter& f, Store* st, FileLock& lock, TaskList& l) {
+    const FilterProgram p = f.compile();
+    auto match = [&](const Task& t) { return p.matches(t); };
+    if (st) {
+        for (const auto& t : st->live()) if (match(t)) l.tasks.push_back(t);
+        return true;
+    }
+    if (!f.due_from && !f.due_to) {
+        // list_cmd applies the filter while it builds its sort keys
+        l = load_tasks(f.state);
+        return true;
+    }
+    if (!due_index_current()) {
+        // rebuilding writes the index, so it is done under the writer lock
+        if (!lock.acquire(FileLock::Exclusive, true)) return false;
+        if (!due_index_current()) build_due_index();
+    }
+    // undated tasks, and legacy dates that are not real, never fall inside a range
+    const uint32_t from = std::max(f.due_from, 1u);
+    const uint32_t to = f.due_to ? f.due_to : LEGACY_DAY;
+    const bool binary = use_binary();
+    bool read = with_file_view(store_path(), [&](std::string_view buf) {
+        TT_PHASE(Phase::Filter);
+        l = search_tasks(due_offsets(from, to), buf, binary, match);
+    });
+    if (!read) l = search_tasks({}, std::string_view(), binary, match);
+    if (f.state != ListFilter::Pending) scan_shard(l, match);
+    return true;
+}
+
+// done/rm --where <conditions>: the conditions are list's, so the same
+// selection can be previewed with tt list first. one pass over the store,
+// one write.
+static int mutate_where(bool rm, const std::vector<std::string>& args, Store* st, std::ostream& out,
+                        std::ostream& err) {
+    TaskFilter f;
+    std::string error;
+    for (size_t i = 2; i < args.size(); ++i) {
+        int r = parse_filter_arg(args, i, f, error);
+        if (r < 0) { err << error << "\n"; return 1; }
+        if (r == 0) { err << "Unknown condition: " << args[i] << "\n"; return 1; }
+    }
+    if (!f.narrowed() && f.state == ListFilter::All) {
+        err << "--where needs at least one condition (see tt list).\n";
+        return 1;
+    }
+    // marking done only changes tasks that are still pending
+    if (!rm && f.state == ListFilter::All) f.state = ListFilter::Pending;
+    const FilterProgram p = f.compile();
+    auto hit = [&](const Task& t) { return p.matches(t); };
+    size_t n = 0;
+    if (st) {
+        std::vector<int> ids;
+        for (const auto& t : st->live()) if (hit(t)) ids.push_back(t.id);
+        for (int id : ids) rm ? st->remove(id) : st->mark_done(id);
+        n = ids.size();
+    } else {
+        TaskList l = load_tasks();
+        auto& v = l.tasks;
+        {
+            TT_PHASE(Phase::Filter);
+            if (rm) {
+                size_t before = v.size();
+                v.erase(std::remove_if(v.begin(), v.end(), hit), v.end());
+                n = before - v.size();
+            } else {
+                for (auto& t : v) if (hit(t)) { t.done = true; ++n; }
+            }
+        }
+        if (n && !save_tasks(v)) { err << "Error: cannot write tasks.\n"; return 1; }
+    }
+    if (rm) out << "Removed " << n << (n == 1 ? " task.\n" : " tasks.\n");
+    else out << "Marked " << n << (n == 1 ? " task done.\n" : " tasks done.\n");
+    return 0;
+}
+
+bool whole_store_command(const std::string& cmd) {
+    static const char* const names[] = {"import", "shard", "archive", "batch", "watch", "sync", "serve"};
+    return std::find(std::begin(names), std::end(names), cmd) != std::end(names);
+}
+
+int run_command(const std::vector<std::string>& args, Store* st, std::ostream& out, std::ostream& err) {
+    if (args.empty()) { help(out); return 0; }
+    const std::string& cmd = args[0];
+    const size_t argc = args.size();
+
+    if (cmd == "help" || cmd == "-h" || cmd == "--help") { help(out); return 0; }
+    if (st && whole_store_command(cmd)) { err << cmd << " is not available in batch or serve mode.\n"; return 1; }
+
+    // commands that go straight to disk hold the lock for their whole
+    // load->save window; batch and serve manage their own
+    FileLock lock;
+    if (!st) {
+        if (cmd == "list" || cmd == "export" || cmd == "find") {
+            lock_for_read(lock);
+        } else if (cmd == "add" || cmd == "done" || cmd == "rm" || cmd == "clear" || cmd == "compact" ||
+                   cmd == "import" || cmd == "shard" || cmd == "archive") {
+            if (!lock.acquire(FileLock::Exclusive, true)) { err << "Error: cannot lock the task store.\n"; return 1; }
+        }
+    }
+
+    if (cmd == "add") {
+        if (argc < 2) { err << "Error: title required.\n"; return 1; }
+        char pr = 'M';
+        uint32_t due = 0;
+        std::vector<std::string> title_parts;
+        for (size_t i = 1; i < argc; ++i) {
+            const std::string& a = args[i];
+            if (a == "-p" && i + 1 < argc) {
+                pr = std::toupper(static_cast<unsigned char>(args[++i][0]));
+                if (pr != 'H' && pr != 'M' && pr != 'L') {
+                    err << "Invalid priority. Use H/M/L.\n"; return 1;
+                }
+            } else if (a == "-d" && i + 1 < argc) {
+                const std::string& d = args[++i];
+                if (!is_valid_date(d)) {
+                    err << "Invalid date, expected YYYY-MM-DD.\n"; return 1;
+                }
+                due = date_to_day(d);
+            } else if (!a.empty() && a[0] == '-') {
+                err << "Unknown flag: " << a << "\n"; return 1;
+            } else {
+                title_parts.push_back(a);
+            }
+        }
+        if (title_parts.empty()) { err << "Error: title required.\n"; return 1; }
+        std::string title;
+        for (size_t i = 0; i < title_parts.size(); ++i) {
+            if (i) title += ' ';
+            title += title_parts[i];
+        }
+        title = trim(title);
+        Task t; t.priority = pr; t.due = due; t.title = title;
+        if (st) {
+            t.id = st->add(std::move(t));
+        } else {
+            IndexHeader h;
+            if (!open_index(h)) { err << "Error: cannot write index.\n"; return 1; }
+            t.id = next_id(h.max_id, id_space());
+            if (!index_set_max(t.id)) { err << "Error: cannot write index.\n"; return 1; }
+            if (!append_journal(journal_add_record(t))) { err << "Error: cannot write journal.\n"; return 1; }
+        }
+        out << "Added task #" << t.id << "\n";
+        return 0;
+    }
+
+    if (cmd == "list") {
+        TaskFilter filter;
+        // default sort
+        std::string sort_key = "due";
+        size_t offset = 0, limit = 0;
+        OutFormat fmt = OutFormat::Table;
+        bool use_cache = true, include_archive = false;
+        size_t mem_limit = 0;
+        std::string error;
+        for (size_t i = 1; i < argc; ++i) {
+            const std::string& a = args[i];
+            int r = parse_filter_arg(args, i, filter, error);
+            if (r < 0) { err << error << "\n"; return 1; }
+            if (r > 0) continue;
+            if (a == "--no-cache") use_cache = false;
+            else if (a == "--include-archive") include_archive = true;
+            else if (a.rfind("--mem-limit=", 0) == 0) {
+                mem_limit = parse_size(a.substr(12));
+                if (!mem_limit) { err << "Invalid --mem-limit value.\n"; return 1; }
+            }
+            else if (a.rfind("--sort=", 0) == 0) sort_key = a.substr(7);
+            else if (a.rfind("--format=", 0) == 0) {
+                if (!parse_format(a.substr(9), fmt)) { err << "Unknown format: " << a.substr(9) << "\n"; return 1; }
+            }
+            else if (a == "--limit" || a == "--offset" || a.rfind("--limit=", 0) == 0 || a.rfind("--offset=", 0) == 0) {
+                size_t eq = a.find('=');
+                std::string val;
+                if (eq != std::string::npos) val = a.substr(eq + 1);
+                else if (i + 1 < argc) val = args[++i];
+                int n = parse_int(val);
+                if (n < 0) { err << "Invalid " << a.substr(0, eq) << " value.\n"; return 1; }
+                (a.rfind("--limit", 0) == 0 ? limit : offset) = static_cast<size_t>(n);
+            }
+            else { err << "Unknown arg: " << a << "\n"; return 1; }
+        }
+        const SortKey key = parse_sort_key(sort_key);
+        // archived tasks are all done, so pending listings never need them
+        const bool archive = include_archive && filter.state != ListFilter::Pending;
+        const bool ranged = filter.due_from || filter.due_to;
+        const bool cacheable = !st && !archive && !filter.narrowed() && use_cache && view_pageable(fmt, offset, limit);
+        DiskSig sig;
+        if (cacheable) {
+            sig = disk_sig();
+            if (serve_view(view_path(filter.state, key, fmt), sig, offset, limit, out)) return 0;
+        }
+        if (archive) {
+            TaskList l;
+            if (filter.narrowed()) {
+                if (!select_tasks(filter, st, lock, l)) { err << "Error: cannot lock the task store.\n"; return 1; }
+            } else if (st) {
+                l.tasks = st->live();
+            } else {
+                l = load_tasks(filter.state);
+            }
+            const FilterProgram p = filter.compile();
+            scan_archive(l, [&](const Task& t) { return p.matches(t); });
+            list_cmd(l.tasks, filter, key, offset, limit, fmt, out);
+        } else if (!st && !ranged && key == SortKey::Id && stream_list(filter, offset, limit, fmt, out)) {
+            // id order is file order: rows went out as they were read
+        } else if (!st && !ranged && mem_limit && list_bytes(filter.state) > mem_limit &&
+                   external_list(filter, key, offset, limit, mem_limit, fmt, out)) {
+            // sorted in runs of at most --mem-limit
+        } else if (filter.narrowed()) {
+            TaskList l;
+            if (!select_tasks(filter, st, lock, l)) { err << "Error: cannot lock the task store.\n"; return 1; }
+            list_cmd(l.tasks, filter, key, offset, limit, fmt, out);
+        } else if (st) {
+            list_cmd(st->live(), filter.state, key, offset, limit, fmt, out);
+        } else if (cacheable) {
+            list_and_cache(filter.state, key, offset, limit, fmt, sig, out);
+        } else {
+            list_cmd(load_tasks(filter.state).tasks, filter.state, key, offset, limit, fmt, out);
+        }
+        return 0;
+    }
+
+    if (cmd == "find") {
+        bool substr = false;
+        std::string sort_key = "due";
+        size_t limit = 0;
+        OutFormat fmt = OutFormat::Table;
+        std::vector<std::string> words;
+        for (size_t i = 1; i < argc; ++i) {
+            const std::string& a = args[i];
+            if (a == "--substr") substr = true;
+            else if (a.rfind("--sort=", 0) == 0) sort_key = a.substr(7);
+            else if (a.rfind("--format=", 0) == 0) {
+                if (!parse_format(a.substr(9), fmt)) { err << "Unknown format: " << a.substr(9) << "\n"; return 1; }
+            }
+            else if (a == "--limit" || a.rfind("--limit=", 0) == 0) {
+                std::string val = a.size() > 7 ? a.substr(8) : (i + 1 < argc ? args[++i] : std::string());
+                int n = parse_int(val);
+                if (n < 0) { err << "Invalid --limit value.\n"; return 1; }
+                limit = static_cast<size_t>(n);
+            }
+            else if (a.size() > 1 && a[0] == '-' && a[1] == '-') { err << "Unknown arg: " << a << "\n"; return 1; }
+            else words.push_back(a);
+        }
+        std::string needle;
+        for (size_t i = 0; i < words.size(); ++i) {
+            if (i) needle += ' ';
+            needle += words[i];
+        }
+        std::vector<SearchTerm> q = parse_query(words);
+        if (substr ? needle.empty() : q.empty()) { err << "Usage: tt find [--substr] <words...>\n"; return 1; }
+        std::function<bool(const Task&)> match;
+        if (substr) match = [&](const Task& t) { return find_substr(t.title, needle) != std::string_view::npos; };
+        else match = [&](const Task& t) { return title_matches(t.title, q); };
+
+        TaskList found;
+        if (st) {
+            for (const auto& t : st->live()) if (match(t)) found.tasks.push_back(t);
+        } else {
+            if (!substr && !search_index_current()) {
+                // rebuilding writes the index, so it is done under the writer lock
+                if (!lock.acquire(FileLock::Exclusive, true)) { err << "Error: cannot lock the task store.\n"; return 1; }
+                if (!search_index_current()) build_search_index();
+            }
+            const bool binary = use_binary();
+            bool read = with_file_view(store_path(), [&](std::string_view buf) {
+                TT_PHASE(Phase::Filter);
+                std::vector<uint64_t> offs = substr ? substr_offsets(buf, binary, needle) : search_offsets(q);
+                found = search_tasks(offs, buf, binary, match);
+            });
+            // no snapshot yet: everything is in the journal
+            if (!read) found = search_tasks({}, std::string_view(), binary, match);
+            scan_shard(found, match);
+        }
+        list_cmd(found.tasks, ListFilter::All, parse_sort_key(sort_key), 0, limit, fmt, out);
+        return 0;
+    }
+
+    if (cmd == "done") {
+        if (argc < 2) { err << "Usage: tt done <id> | --where <conditions>\n"; return 1; }
+        if (args[1] == "--where") return mutate_where(false, args, st, out, err);
+        int id = parse_int(args[1]); if (id < 0) { err << "Invalid id.\n"; return 1; }
+        if (st) {
+            if (!st->mark_done(id)) { err << "Task not found.\n"; return 1; }
+        } else {
+            IndexHeader h;
+            if (!open_index(h)) { err << "Error: cannot write index.\n"; return 1; }
+            auto hit = index_find(id);
+            if (hit && hit->off == IDX_DEAD) { err << "Task not found.\n"; return 1; }
+            bool ok = true;
+            if (hit && hit->off != IDX_NOPATCH) ok = patch_done(hit->off);
+            else if (hit || journal_has(id)) ok = append_journal(journal_id_record('x', id));
+            else if (!shard_has(id)) { err << "Task not found.\n"; return 1; } // shard tasks are done already
+            if (!ok) { err << "Error: cannot write tasks.\n"; return 1; }
+        }
+        out << "Marked #" << id << " done.\n"; return 0;
+    }
+
+    if (cmd == "rm") {
+        if (argc < 2) { err << "Usage: tt rm <id> | --where <conditions>\n"; return 1; }
+        if (args[1] == "--where") return mutate_where(true, args, st, out, err);
+        int id = parse_int(args[1]); if (id < 0) { err << "Invalid id.\n"; return 1; }
+        if (st) {
+            if (!st->remove(id)) { err << "Task not found.\n"; return 1; }
+        } else {
+            IndexHeader h;
+            if (!open_index(h)) { err << "Error: cannot write index.\n"; return 1; }
+            auto hit = index_find(id);
+            bool live = hit ? hit->off != IDX_DEAD : journal_has(id) || shard_has(id);
+            if (!live) { err << "Task not found.\n"; return 1; }
+            if (!append_journal(journal_id_record('-', id))) { err << "Error: cannot write journal.\n"; return 1; }
+            if (hit) index_tombstone(hit->pos);
+        }
+        out << "Removed #" << id << ".\n"; return 0;
+    }
+
+    if (cmd == "clear") {
+        bool clear_all = false;
+        for (size_t i = 1; i < argc; ++i) {
+            const std::string& a = args[i];
+            if      (a == "--all") clear_all = true;
+            else if (a == "--done") { /* default behavior */ }
+            else { err << "Unknown arg: " << a << "\n"; return 1; }
+        }
+        if (st) {
+            st->clear(clear_all);
+        } else {
+            // pending tasks are all that survive, so a done shard is never read
+            TaskList l = load_tasks(ListFilter::Pending);
+            auto& v = l.tasks;
+            if (clear_all) v.clear();
+            if (!save_tasks(v)) { err << "Error: cannot write tasks.\n"; return 1; }
+        }
+        out << (clear_all ? "Cleared all tasks." : "Cleared completed tasks.") << "\n";
+        return 0;
+    }
+
+    if (cmd == "compact") {
+        if (st) st->rewrite = true;
+        else if (!save_tasks(load_tasks().tasks)) { err << "Error: cannot write tasks.\n"; return 1; }
+        out << "Compacted journal into " << store_path().filename().string() << ".\n";
+        return 0;
+    }
+
+    if (cmd == "archive") {
+        uint32_t before = 0;
+        for (size_t i = 1; i < argc; ++i) {
+            const std::string& a = args[i];
+            if (a.rfind("--older-than=", 0) == 0) {
+                int n = parse_int(a.substr(13));
+                if (n < 0) { err << "Invalid --older-than value.\n"; return 1; }
+                const uint32_t day = today();
+                before = day > static_cast<uint32_t>(n) ? day - static_cast<uint32_t>(n) : 1;
+            }
+            else { err << "Unknown arg: " << a << "\n"; return 1; }
+        }
+        TaskList l = load_tasks();
+        std::vector<Task> rest;
+        size_t moved = 0;
+        const std::string file = archive_path().filename().string();
+        if (!archive_tasks(l.tasks, before, rest, moved)) { err << "Error: cannot write " << file << ".\n"; return 1; }
+        if (moved && !save_tasks(rest)) { err << "Error: cannot write tasks.\n"; return 1; }
+        out << "Archived " << moved << (moved == 1 ? " task" : " tasks") << " into " << file << ".\n";
+        return 0;
+    }
+
+    if (cmd == "shard") {
+        bool off = false;
+        for (size_t i = 1; i < argc; ++i) {
+            if (args[i] == "--off") off = true;
+            else { err << "Unknown arg: " << args[i] << "\n"; return 1; }
+        }
+        const std::string shard = shard_path(use_binary()).filename().string();
+        if (off && !sharded()) { out << "The store is not sharded.\n"; return 0; }
+        TaskList l = load_tasks();
+        if (!save_tasks(l.tasks, !off)) { err << "Error: cannot write tasks.\n"; return 1; }
+        if (off) {
+            out << "Merged " << shard << " back into " << store_path().filename().string() << ".\n";
+        } else {
+            size_t n = std::count_if(l.tasks.begin(), l.tasks.end(), [](const Task& t){ return t.done; });
+            out << "Kept " << n << (n == 1 ? " completed task in " : " completed tasks in ") << shard << ".\n";
+        }
+        return 0;
+    }
+
+    if (cmd == "export") {
+        std::string out_file;
+        OutFormat fmt = OutFormat::Tsv;
+        for (size_t i = 1; i < argc; ++i) {
+            const std::string& a = args[i];
+            if (a == "--tsv") fmt = OutFormat::Tsv;
+            else if (a.rfind("--format=", 0) == 0) {
+                if (!parse_format(a.substr(9), fmt)) { err << "Unknown format: " << a.substr(9) << "\n"; return 1; }
+            }
+            else if (a.size() > 1 && a[0] == '-') { err << "Unknown arg: " << a << "\n"; return 1; }
+            else out_file = a;
+        }
+        // a file is written beside its final name and renamed into place, so
+        // exporting over the snapshot itself is safe
+        std::ofstream file;
+        fs::path tmp;
+        if (!out_file.empty() && out_file != "-") {
+            tmp = out_file + ".tmp";
+            file.open(tmp, std::ios::binary | std::ios::trunc);
+            if (!file) { err << "Error: cannot write " << out_file << "\n"; return 1; }
+        }
+        {
+            TaskWriter w(fmt, file.is_open() ? file : out);
+            if (st) for (const auto& t : st->live()) w.write(t);
+            else export_tasks(w);
+        }
+        if (file.is_open()) {
+            file.close();
+            std::error_code ec;
+            if (file.fail() || (fs::rename(tmp, out_file, ec), ec)) {
+                fs::remove(tmp, ec);
+                err << "Error: cannot write " << out_file << "\n";
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    if (cmd == "import") {
+        std::string format = "tsv", in_arg;
+        for (size_t i = 1; i < argc; ++i) {
+            const std::string& a = args[i];
+            if (a.rfind("--format=", 0) == 0) format = a.substr(9);
+            else if (a.size() > 1 && a[0] == '-') { err << "Unknown arg: " << a << "\n"; return 1; }
+            else in_arg = a;
+        }
+        if (format == "csv" || format == "ndjson") {
+            if (in_arg.empty()) { err << "Usage: tt import --format=csv|ndjson <file|->\n"; return 1; }
+            std::ifstream file;
+            if (in_arg != "-") {
+                file.open(in_arg, std::ios::binary);
+                if (!file) { err << "No such file: " << in_arg << "\n"; return 1; }
+            }
+            size_t added = 0;
+            std::string error;
+            if (!import_tasks(in_arg == "-" ? std::cin : file, format == "csv", added, error)) {
+                err << error << "\n";
+                return 1;
+            }
+            out << "Imported " << added << " tasks.\n";
+            return 0;
+        }
+        if (format != "tsv") { err << "Unknown format: " << format << "\n"; return 1; }
+        fs::path in_file = in_arg.empty() ? data_path() : fs::path(in_arg);
+        std::error_code ec;
+        if (!fs::exists(in_file, ec)) { err << "No such file: " << in_file.string() << "\n"; return 1; }
+        // re-importing the live tasks.tsv folds its journal in as well
+        fs::path tsv_log = data_path();
+        tsv_log += ".log";
+        bool live = !use_binary() && fs::equivalent(in_file, data_path(), ec);
+        TaskList l = live ? load_tasks() : load_tsv(in_file);
+        const std::vector<Task>& v = l.tasks;
+        fs::path tsv_idx = data_path();
+        tsv_idx += ".idx";
+        IndexHeader h;
+        bool stale = false;
+        int32_t max_id = read_index_header(h, stale) ? h.max_id : 0;
+        // a done shard carries over into the binary format with the rest
+        const bool shard = sharded() || fs::exists(shard_path(true), ec);
+        const std::string bin_file = bin_path().filename().string();
+        if (!write_snapshot(v, true, shard)) { err << "Error: cannot write " << bin_file << ".\n"; return 1; }
+        fs::remove(journal_path(), ec);
+        // the live text store is folded into tasks.bin whole, so it goes.
+        // importing another file replaces the store's tasks instead, and
+        // the old text files, which hold the ones it drops, are left alone
+        std::vector<std::string> left;
+        for (fs::path p : {data_path(), tsv_log, shard_path(false)}) {
+            if (!fs::exists(p, ec)) continue;
+            if (live) fs::remove(p, ec);
+            else if (!fs::equivalent(p, in_file, ec)) left.push_back(p.filename().string());
+        }
+        fs::remove(tsv_idx, ec);
+        for (const char* ext : {".fts", ".due"}) {
+            fs::path side = data_path();
+            side += ext;
+            fs::remove(side, ec);
+        }
+        fs::path tsv_views = data_path();
+        tsv_views += ".views";
+        fs::remove_all(tsv_views, ec);
+        build_index(max_id);
+        out << "Imported " << v.size() << " tasks into " << bin_file << ".\n";
+        for (const auto& f : left) out << "Left " << f << " as it was; it is no longer read.\n";
+        return 0;
+    }
+
+    if (cmd == "batch") {
+        if (argc > 1 && args[1] != "-") {
+            std::ifstream in(args[1]);
+            if (!in) { err << "Cannot open " << args[1] << "\n"; return 1; }
+            return batch_cmd(in, out, err);
+        }
+        return batch_cmd(std::cin, out, err);
+    }
+
+    if (cmd == "watch") {
+        return watch_cmd(args, out, err);
+    }
+
+    if (cmd == "sync") {
+        return sync_cmd(args, out, err);
+    }
+
+    if (cmd == "serve") {
+        return serve_cmd(args, out, err);
+    }
+
+    err << "Unknown command. Try 'tt help'.\n";
+    return 1;
+}
+
+// one command per line, same grammar as the command line. blank lines and
+// lines starting with '#' are skipped. errors are reported with their line
+// number, and the store is written once after the last line.
+int batch_cmd(std::istream& in, std::ostream& out, std::ostream& err) {
+    FileLock lock;
+    if (!lock.acquire(FileLock::Exclusive, true)) { err << "Error: cannot lock the task store.\n"; return 1; }
+    Store st = Store::open();
+    st.held_lock = true;
+    std::string line;
+    size_t lineno = 0, ok = 0, failed = 0;
+    while (std::getline(in, line)) {
+        ++lineno;
+        if (is_blank(line) || trim(line)[0] == '#') continue;
+        std::vector<std::string> args;
+        std::ostringstream cmd_err;
+        int rc = 1;
+        if (!split_args(line, args)) cmd_err << "Unterminated quote.\n";
+        else rc = run_command(args, &st, out, cmd_err);
+        if (rc == 0 && g_sync == SyncMode::Always && !st.flush(&err)) {
+            cmd_err << "Error: cannot write tasks.\n";
+            rc = 1;
+        }
+        if (rc == 0) { ++ok; continue; }
+        ++failed;
+        std::string msg = cmd_err.str();
+        if (msg.empty()) msg = "failed\n";
+        err << "line " << lineno << ": " << msg;
+    }
+    if (!st.flush(&err)) { err << "Error: cannot write tasks; batch not saved.\n"; return 1; }
+    err << "batch: " << ok << " ok, " << failed << " failed\n";
+    return failed ? 1 : 0;
+}
+
+int run(const fs::path& dir, const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    std::error_code ec;
+    StoreDirScope scope(fs::absolute(dir, ec));
+    return run_command(args, nullptr, out, err);
+}
+
+} // namespace tt
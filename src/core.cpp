@@ -0,0 +1,302 @@
+// store-wide pieces: threads, stats, day numbers and store paths
+#include "tt_internal.h"
+
+namespace tt {
+
+TaskList join_lists(std::vector<TaskList>& parts) {
+    TaskList out;
+    size_t n = 0;
+    for (const auto& p : parts) n += p.tasks.size();
+    out.tasks.reserve(n);
+    for (auto& p : parts) {
+        out.tasks.insert(out.tasks.end(), p.tasks.begin(), p.tasks.end());
+        out.titles.adopt(std::move(p.titles));
+    }
+    return out;
+}
+
+unsigned g_threads = 0;
+
+unsigned thread_count() {
+    unsigned n = g_threads ? g_threads : std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+StatsMode g_stats = StatsMode::Off;
+
+Stats g_stat;
+
+std::atomic<uint64_t> g_allocs{0};
+
+bool parse_stats(const std::string& s, StatsMode& m) {
+    if (s == "1" || s == "text") m = StatsMode::Text;
+    else if (s == "json") m = StatsMode::Json;
+    else if (s == "0" || s.empty()) m = StatsMode::Off;
+    else return false;
+    return true;
+}
+
+void print_stats(const std::string& cmd, double total_ms, std::ostream& os) {
+#ifdef TT_NO_STATS
+    (void)cmd; (void)total_ms;
+    os << "tt: stats are not available in this build.\n";
+#else
+    static const char* names[] = {"load", "filter", "sort", "output", "save"};
+    const uint64_t allocs = g_allocs.load(std::memory_order_relaxed);
+    char line[96];
+    if (g_stats == StatsMode::Json) {
+        os << "{\"command\":\"" << cmd << "\"";
+        std::snprintf(line, sizeof line, ",\"total_ms\":%.3f", total_ms);
+        os << line;
+        for (int i = 0; i < static_cast<int>(Phase::Count); ++i) {
+            std::snprintf(line, sizeof line, ",\"%s_ms\":%.3f", names[i], g_stat.ms[i]);
+            os << line;
+        }
+        os << ",\"bytes_read\":" << g_stat.bytes_read << ",\"bytes_written\":" << g_stat.bytes_written
+           << ",\"bytes_out\":" << g_stat.bytes_out << ",\"tasks\":" << g_stat.tasks << ",\"rows\":" << g_stat.rows
+           << ",\"allocs\":" << allocs << ",\"scanner\":\"" << scan_level_name() << "\"}\n";
+        return;
+    }
+    os << "tt stats (" << cmd << ")\n";
+    for (int i = 0; i < static_cast<int>(Phase::Count); ++i) {
+        std::snprintf(line, sizeof line, "  %-14s %10.3f ms\n", names[i], g_stat.ms[i]);
+        os << line;
+    }
+    std::snprintf(line, sizeof line, "  %-14s %10.3f ms\n", "total", total_ms);
+    os << line;
+    auto count = [&](const char* name, uint64_t v) {
+        std::snprintf(line, sizeof line, "  %-14s %10llu\n", name, static_cast<unsigned long long>(v));
+        os << line;
+    };
+    count("bytes read", g_stat.bytes_read);
+    count("bytes written", g_stat.bytes_written);
+    count("bytes out", g_stat.bytes_out);
+    count("tasks loaded", g_stat.tasks);
+    count("rows printed", g_stat.rows);
+    count("allocations", allocs);
+    std::snprintf(line, sizeof line, "  %-14s %10s\n", "scanner", scan_level_name());
+    os << line;
+#endif
+}
+
+// day numbers: days since 0000-03-01 plus one, so 0 can mean "no date".
+// proleptic Gregorian, after Howard Hinnant's days_from_civil.
+static uint32_t civil_to_day(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return static_cast<uint32_t>(era * 146097 + static_cast<int>(doe) + 1);
+}
+
+// whether d is DDDD-DD-DD. with SSE2 or NEON the ten bytes, copied into a
+// zeroed 16-byte lane, are checked in one go: each byte minus '0' must be at
+// most 9 where a digit belongs, and equal '-' where a dash does.
+static bool date_shape(std::string_view d) {
+    if (d.size() != 10) return false;
+#if defined(TT_HAVE_SSE2) || defined(TT_HAVE_NEON)
+    alignas(16) unsigned char buf[16] = {};
+    std::memcpy(buf, d.data(), 10);
+#endif
+#if defined(TT_HAVE_SSE2)
+    const __m128i x = _mm_load_si128(reinterpret_cast<const __m128i*>(buf));
+    const __m128i over = _mm_subs_epu8(_mm_sub_epi8(x, _mm_set1_epi8('0')), _mm_set1_epi8(9));
+    const unsigned digit = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(over, _mm_setzero_si128())));
+    const unsigned dash = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('-'))));
+    return (digit & 0x36f) == 0x36f && (dash & 0x90) == 0x90;
+#elif defined(TT_HAVE_NEON)
+    static const uint8_t digit_at[16] = {0xff, 0xff, 0xff, 0xff, 0, 0xff, 0xff, 0, 0xff, 0xff};
+    static const uint8_t dash_at[16] = {0, 0, 0, 0, 0xff, 0, 0, 0xff};
+    const uint8x16_t x = vld1q_u8(buf);
+    const uint8x16_t digit = vandq_u8(vcleq_u8(vsubq_u8(x, vdupq_n_u8('0')), vdupq_n_u8(9)), vld1q_u8(digit_at));
+    const uint8x16_t dash = vandq_u8(vceqq_u8(x, vdupq_n_u8('-')), vld1q_u8(dash_at));
+    // every lane is either a matched position or one that doesn't matter
+    const uint8x16_t ok = vorrq_u8(vorrq_u8(digit, dash), vmvnq_u8(vorrq_u8(vld1q_u8(digit_at), vld1q_u8(dash_at))));
+    return vminvq_u8(ok) == 0xff;
+#else
+    for (size_t i = 0; i < 10; ++i) {
+        if (i == 4 || i == 7 ? d[i] != '-' : d[i] < '0' || d[i] > '9') return false;
+    }
+    return true;
+#endif
+}
+
+uint32_t date_to_day(std::string_view d) {
+    if (!date_shape(d)) return 0;
+    auto num = [&](size_t b, size_t n) {
+        int v = 0;
+        for (size_t i = b; i < b + n; ++i) v = v * 10 + (d[i] - '0');
+        return v;
+    };
+    int y = num(0, 4), m = num(5, 2), dd = num(8, 2);
+    if (y < 1 || m < 1 || m > 12 || dd < 1) return 0;
+    static const int days_in[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+    if (dd > days_in[m - 1] + (m == 2 && leap)) return 0;
+    return civil_to_day(y, static_cast<unsigned>(m), static_cast<unsigned>(dd));
+}
+
+uint32_t stored_day(std::string_view d) {
+    if (uint32_t day = date_to_day(d)) return day;
+    if (!date_shape(d)) return 0;
+    uint32_t v = 0;
+    for (size_t i = 0; i < 10; ++i)
+        if (i != 4 && i != 7) v = v * 10 + static_cast<uint32_t>(d[i] - '0');
+    return LEGACY_DAY + v;
+}
+
+uint32_t legacy_sort_day(uint32_t n) {
+    const uint32_t v = n - LEGACY_DAY;
+    const int y = static_cast<int>(v / 10000);
+    const unsigned m = v / 100 % 100, d = v % 100;
+    // the last real date at or before the text, as the baseline compared
+    // dates as strings
+    if (m == 0) return y ? civil_to_day(y - 1, 12, 31) : 1;
+    if (m > 12) return civil_to_day(y, 12, 31);
+    if (d == 0) return y || m > 1 ? civil_to_day(y, m, 1) - 1 : 1;
+    static const unsigned days_in[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    const bool leap = y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+    return civil_to_day(y, m, std::min(d, days_in[m - 1] + (m == 2 && leap)));
+}
+
+// writes the 10 characters of YYYY-MM-DD for day number n
+void format_day(uint32_t n, char* out) {
+    if (n >= LEGACY_DAY) {
+        uint32_t v = n - LEGACY_DAY;
+        for (int i = 9; i >= 0; --i) {
+            if (i == 4 || i == 7) { out[i] = '-'; continue; }
+            out[i] = static_cast<char>('0' + v % 10);
+            v /= 10;
+        }
+        return;
+    }
+    const int z = static_cast<int>(n) - 1;
+    const int era = z / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    unsigned y = static_cast<unsigned>(static_cast<int>(yoe) + era * 400 + (m <= 2)) % 10000;
+    out[0] = static_cast<char>('0' + y / 1000);
+    out[1] = static_cast<char>('0' + y / 100 % 10);
+    out[2] = static_cast<char>('0' + y / 10 % 10);
+    out[3] = static_cast<char>('0' + y % 10);
+    out[4] = '-';
+    out[5] = static_cast<char>('0' + m / 10);
+    out[6] = static_cast<char>('0' + m % 10);
+    out[7] = '-';
+    out[8] = static_cast<char>('0' + d / 10);
+    out[9] = static_cast<char>('0' + d % 10);
+}
+
+std::string day_to_date(uint32_t n) {
+    char buf[10];
+    format_day(n, buf);
+    return std::string(buf, 10);
+}
+
+uint32_t today() {
+    auto secs = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    return civil_to_day(1970, 1, 1) + static_cast<uint32_t>(secs / 86400);
+}
+
+// storage
+thread_local fs::path g_store_dir;
+thread_local std::string g_store_name;
+
+fs::path store_dir() {
+    return g_store_dir.empty() ? fs::current_path() : g_store_dir;
+}
+
+std::string store_name() {
+    return g_store_name.empty() ? "tasks" : g_store_name;
+}
+
+fs::path data_path() {
+    return store_dir() / (store_name() + ".tsv");
+}
+
+fs::path bin_path() {
+    return store_dir() / (store_name() + ".bin");
+}
+
+bool valid_list_name(std::string_view name) {
+    if (name.empty() || name.size() > 128 || name[0] == '.') return false;
+    for (char c : name)
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') return false;
+    return true;
+}
+
+bool split_store_file(const fs::path& file, fs::path& dir, std::string& name) {
+    std::error_code ec;
+    fs::path abs = fs::absolute(file, ec);
+    if (ec || !abs.has_filename()) return false;
+    std::string base = abs.filename().string();
+    for (const char* ext : {".tsv", ".bin"}) {
+        if (base.size() > 4 && base.compare(base.size() - 4, 4, ext) == 0) {
+            base.resize(base.size() - 4);
+            break;
+        }
+    }
+    if (!valid_list_name(base)) return false;
+    dir = abs.parent_path();
+    name = base;
+    return true;
+}
+
+bool use_binary() {
+    std::error_code ec;
+    return fs::exists(bin_path(), ec);
+}
+
+fs::path store_path() {
+    return use_binary() ? bin_path() : data_path();
+}
+
+fs::path shard_path(bool binary) {
+    return store_dir() / (store_name() + (binary ? ".done.bin" : ".done.tsv"));
+}
+
+bool sharded() {
+    std::error_code ec;
+    return fs::exists(shard_path(use_binary()), ec);
+}
+
+std::string encode_field(std::string_view s) {
+    std::string out(s);
+    for (char& c : out) if (c == SEP) c = '/';
+    out.erase(std::remove(out.begin(), out.end(), '\n'), out.end());
+    out.erase(std::remove(out.begin(), out.end(), '\r'), out.end());
+    return out;
+}
+
+bool parse_task(std::string_view line, Task& t, TitleArena* arena) {
+    uint32_t seps[5];
+    unsigned n = 0;
+    for (size_t p = line.find(SEP); p != std::string_view::npos && n < 5; p = line.find(SEP, p + 1))
+        seps[n++] = static_cast<uint32_t>(p);
+    return parse_task_fields(line, seps, n, t, arena);
+}
+
+bool parse_task_fields(std::string_view line, const uint32_t* seps, unsigned n, Task& t, TitleArena* arena) {
+    if (n < 4) return false;
+    const char* b = line.data();
+    const char* e = b + seps[0];
+    while (b < e && (*b == ' ' || *b == '\t')) ++b;
+    if (std::from_chars(b, e, t.id).ec != std::errc()) return false;
+    auto field = [&](unsigned i) { return line.substr(seps[i - 1] + 1, seps[i] - seps[i - 1] - 1); };
+    const std::string_view done = field(1), prio = field(2), due = field(3);
+    t.done = done == "1";
+    t.priority = prio.empty() ? 'M' : prio[0];
+    t.due = due == "-" ? 0 : stored_day(due);
+    const size_t title_at = seps[3] + 1;
+    const std::string_view title = line.substr(title_at, (n > 4 ? seps[4] : line.size()) - title_at);
+    t.title = arena ? arena->intern(title) : title;
+    return true;
+}
+
+} // namespace tt
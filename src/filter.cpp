@@ -0,0 +1,112 @@
+// task filters: the conditions list, done --where and rm --where share
+#include "tt_internal.h"
+
+namespace tt {
+
+bool TaskFilter::narrowed() const {
+    return prio_mask != 7 || due_from || due_to || !ids.empty() || !words.empty();
+}
+
+FilterProgram TaskFilter::compile() const {
+    FilterProgram p;
+    p.lut = 0;
+    for (unsigned w = 0; w < 3; ++w) {
+        if (!(prio_mask >> w & 1)) continue;
+        if (state != ListFilter::Done) p.lut |= static_cast<uint8_t>(1u << (w << 1));
+        if (state != ListFilter::Pending) p.lut |= static_cast<uint8_t>(1u << (w << 1 | 1));
+    }
+    if (due_from || due_to) {
+        p.lo = std::max(due_from, 1u);
+        const uint32_t to = due_to ? due_to : LEGACY_DAY;
+        p.span = to - std::min(p.lo, to);
+    } else {
+        p.lo = 0;
+        p.span = UINT32_MAX;
+    }
+    p.rest = ids.empty() && words.empty() ? nullptr : this;
+    return p;
+}
+
+bool TaskFilter::matches(const Task& t) const {
+    return compile().matches(t);
+}
+
+bool TaskFilter::matches_rest(const Task& t) const {
+    if (!ids.empty()) {
+        // ranges are sorted and disjoint
+        auto it = std::upper_bound(ids.begin(), ids.end(), t.id,
+                                   [](int id, const std::pair<int, int>& r) { return id < r.first; });
+        if (it == ids.begin() || std::prev(it)->second < t.id) return false;
+    }
+    return words.empty() || title_matches(t.title, words);
+}
+
+// "3", "1-50" and comma-separated lists of both, merged into sorted
+// disjoint ranges
+static bool parse_id_ranges(std::string_view s, std::vector<std::pair<int, int>>& out) {
+    while (!s.empty()) {
+        size_t comma = s.find(',');
+        std::string_view one = s.substr(0, comma);
+        s.remove_prefix(comma == std::string_view::npos ? s.size() : comma + 1);
+        size_t dash = one.find('-');
+        std::string_view a = one.substr(0, dash);
+        std::string_view b = dash == std::string_view::npos ? a : one.substr(dash + 1);
+        int lo = 0, hi = 0;
+        if (std::from_chars(a.data(), a.data() + a.size(), lo).ptr != a.data() + a.size() || a.empty()) return false;
+        if (std::from_chars(b.data(), b.data() + b.size(), hi).ptr != b.data() + b.size() || b.empty()) return false;
+        if (lo < 0 || hi < lo) return false;
+        out.emplace_back(lo, hi);
+    }
+    std::sort(out.begin(), out.end());
+    size_t w = 0;
+    for (size_t i = 0; i < out.size(); ++i) {
+        if (w && out[i].first <= out[w - 1].second + 1) out[w - 1].second = std::max(out[w - 1].second, out[i].second);
+        else out[w++] = out[i];
+    }
+    out.resize(w);
+    return true;
+}
+
+int parse_filter_arg(const std::vector<std::string>& args, size_t& i, TaskFilter& f, std::string& error) {
+    const std::string& a = args[i];
+    if (a == "--all")     { f.state = ListFilter::All; return 1; }
+    if (a == "--pending") { f.state = ListFilter::Pending; return 1; }
+    if (a == "--done")    { f.state = ListFilter::Done; return 1; }
+    // the rest take a value, as --opt=value or --opt value
+    static const char* opts[] = {"--due-before", "--due-after", "--ids", "--priority", "--match"};
+    const char* opt = nullptr;
+    for (const char* o : opts)
+        if (a.rfind(o, 0) == 0 && (a.size() == std::strlen(o) || a[std::strlen(o)] == '=')) opt = o;
+    if (!opt) return 0;
+    std::string val;
+    size_t eq = a.find('=');
+    if (eq != std::string::npos) val = a.substr(eq + 1);
+    else if (i + 1 < args.size()) val = args[++i];
+    const std::string o = opt;
+    if (o == "--due-before" || o == "--due-after") {
+        uint32_t day = date_to_day(val);
+        if (!day) { error = "Invalid date, expected YYYY-MM-DD."; return -1; }
+        if (o == "--due-before") f.due_to = day;
+        else f.due_from = day + 1;
+    } else if (o == "--ids") {
+        if (!parse_id_ranges(val, f.ids) || f.ids.empty()) { error = "Invalid --ids, expected e.g. 1-50,72."; return -1; }
+    } else if (o == "--priority") {
+        f.prio_mask = 0;
+        for (char c : val) {
+            char p = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            if (p == ',') continue;
+            if (p != 'H' && p != 'M' && p != 'L') { error = "Invalid priority. Use H/M/L."; return -1; }
+            f.prio_mask |= static_cast<uint8_t>(1u << prio_weight(p));
+        }
+        if (!f.prio_mask) { error = "Invalid priority. Use H/M/L."; return -1; }
+    } else {
+        std::vector<std::string> words;
+        split_args(val, words);
+        std::vector<SearchTerm> q = parse_query(words);
+        if (q.empty()) { error = "--match needs at least one word."; return -1; }
+        f.words.insert(f.words.end(), q.begin(), q.end());
+    }
+    return 1;
+}
+
+} // namespace tt
@@ -0,0 +1,208 @@
+// the sidecar .idx that lets done/rm/add work without loading the store.
+// layout in tt_internal.h.
+#include "tt_internal.h"
+
+namespace tt {
+
+fs::path index_path() {
+    fs::path p = store_path();
+    p += ".idx";
+    return p;
+}
+
+void snapshot_sig(uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    fs::path p = store_path();
+    size = 0; mtime = 0;
+    if (!fs::exists(p, ec)) return;
+    size = static_cast<uint64_t>(fs::file_size(p, ec));
+    mtime = static_cast<int64_t>(fs::last_write_time(p, ec).time_since_epoch().count());
+}
+
+bool parse_journal_id(std::string_view rest, int& id) {
+    return std::from_chars(rest.data(), rest.data() + rest.size(), id).ec == std::errc();
+}
+
+// reads the header; false if missing or corrupt. stale tells whether it no
+// longer matches the snapshot on disk.
+bool read_index_header(IndexHeader& h, bool& stale) {
+    std::ifstream in(index_path(), std::ios::binary);
+    char buf[IDX_HEADER];
+    if (!in.read(buf, IDX_HEADER)) return false;
+    if (std::memcmp(buf, IDX_MAGIC, 4) != 0 || get_u32(buf + 4) != IDX_VERSION) return false;
+    std::memcpy(&h.snap_size, buf + 8, 8);
+    std::memcpy(&h.snap_mtime, buf + 16, 8);
+    std::memcpy(&h.max_id, buf + 24, 4);
+    h.count = get_u32(buf + 28);
+    uint64_t size; int64_t mtime;
+    snapshot_sig(size, mtime);
+    stale = size != h.snap_size || mtime != h.snap_mtime;
+    return true;
+}
+
+// rescans the snapshot for done-byte offsets and the journal for removals
+// and added ids. min_max_id keeps ids from being reused after compaction.
+void build_index(int32_t min_max_id) {
+    std::vector<std::pair<int32_t, uint64_t>> entries;
+    int32_t max_id = min_max_id;
+    if (use_binary()) {
+        with_file_view(bin_path(), [&](std::string_view buf) {
+            if (buf.size() < BIN_HEADER || std::memcmp(buf.data(), BIN_MAGIC, 4) != 0) return;
+            const uint32_t count = get_u32(buf.data() + 8);
+            if (buf.size() < BIN_HEADER + static_cast<size_t>(count) * BIN_RECORD) return;
+            entries.reserve(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                size_t at = BIN_HEADER + static_cast<size_t>(i) * BIN_RECORD;
+                int32_t id;
+                std::memcpy(&id, buf.data() + at, 4);
+                entries.emplace_back(id, at + 4);
+            }
+        });
+    } else {
+        with_file_view(data_path(), [&](std::string_view buf) {
+            size_t at = 0;
+            while (at < buf.size()) {
+                size_t nl = buf.find('\n', at);
+                if (nl == std::string_view::npos) nl = buf.size();
+                std::string_view line = buf.substr(at, nl - at);
+                size_t p1 = line.find(SEP);
+                Task t;
+                if (p1 != std::string_view::npos && !is_blank(line) && parse_task(line, t)) {
+                    bool one_byte = line.size() > p1 + 2 && line[p1 + 2] == SEP;
+                    entries.emplace_back(t.id, one_byte ? at + p1 + 1 : IDX_NOPATCH);
+                }
+                at = nl + 1;
+            }
+        });
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto& a, const auto& b){ return a.first < b.first; });
+    for (const auto& e : entries) max_id = std::max(max_id, e.first);
+    // the done shard is left out of the entries (done/rm find its tasks by
+    // scanning it), but without an old max neither its ids nor the archive's
+    // may be handed out again
+    if (!min_max_id && sharded()) {
+        const bool binary = use_binary();
+        with_file_view(shard_path(binary), [&](std::string_view buf) {
+            for_each_snapshot_id(buf, binary, [&](int id) { max_id = std::max(max_id, id); });
+        });
+    }
+    if (!min_max_id) max_id = std::max(max_id, archive_max_id());
+
+    for_each_record([&](std::string_view line) {
+        if (line.size() < 3 || line[1] != SEP) return;
+        int id = 0;
+        if (!parse_journal_id(line.substr(2), id)) return;
+        auto it = std::lower_bound(entries.begin(), entries.end(), id,
+                                   [](const auto& e, int v){ return e.first < v; });
+        bool hit = it != entries.end() && it->first == id;
+        if (line[0] == '+') {
+            max_id = std::max(max_id, id);
+            if (hit) it->second = IDX_NOPATCH;
+        } else if (line[0] == '-' && hit) {
+            it->second = IDX_DEAD;
+        }
+    });
+
+    uint64_t size; int64_t mtime;
+    snapshot_sig(size, mtime);
+    std::string out;
+    out.reserve(IDX_HEADER + entries.size() * IDX_ENTRY);
+    out.append(IDX_MAGIC, 4);
+    put_u32(out, IDX_VERSION);
+    out.append(reinterpret_cast<const char*>(&size), 8);
+    out.append(reinterpret_cast<const char*>(&mtime), 8);
+    out.append(reinterpret_cast<const char*>(&max_id), 4);
+    put_u32(out, static_cast<uint32_t>(entries.size()));
+    for (const auto& e : entries) {
+        out.append(reinterpret_cast<const char*>(&e.first), 4);
+        put_u32(out, 0);
+        out.append(reinterpret_cast<const char*>(&e.second), 8);
+    }
+    // Store::open and serve rebuild a stale index holding only the shared
+    // lock, so two readers may race here; each writes a temp file of its own
+    // and either rename leaves a whole index
+    replace_file(index_path(), out, true);
+}
+
+// header of a current index, rebuilding it first if it is missing or stale
+bool open_index(IndexHeader& h) {
+    bool stale = false;
+    bool ok = read_index_header(h, stale);
+    if (ok && !stale) return true;
+    build_index(ok ? h.max_id : 0);
+    return read_index_header(h, stale) && !stale;
+}
+
+std::optional<IndexHit> index_find(int id) {
+    std::optional<IndexHit> hit;
+    with_file_view(index_path(), [&](std::string_view buf) {
+        if (buf.size() < IDX_HEADER) return;
+        size_t n = std::min<size_t>(get_u32(buf.data() + 28), (buf.size() - IDX_HEADER) / IDX_ENTRY);
+        const char* base = buf.data() + IDX_HEADER;
+        size_t lo = 0, hi = n;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            int32_t mid_id;
+            std::memcpy(&mid_id, base + mid * IDX_ENTRY, 4);
+            if (mid_id < id) lo = mid + 1; else hi = mid;
+        }
+        int32_t found;
+        if (lo == n) return;
+        std::memcpy(&found, base + lo * IDX_ENTRY, 4);
+        if (found != id) return;
+        uint64_t off;
+        std::memcpy(&off, base + lo * IDX_ENTRY + 8, 8);
+        hit = IndexHit{lo, off};
+    });
+    return hit;
+}
+
+bool index_set_max(int32_t max_id) {
+    return patch_bytes(index_path(), 24, &max_id, 4);
+}
+
+void index_tombstone(size_t pos) {
+    patch_bytes(index_path(), IDX_HEADER + pos * IDX_ENTRY + 8, &IDX_DEAD, 8);
+}
+
+void index_unpatchable(size_t pos) {
+    patch_bytes(index_path(), IDX_HEADER + pos * IDX_ENTRY + 8, &IDX_NOPATCH, 8);
+}
+
+// flips the done byte of a snapshot record in place and re-signs the index
+bool patch_done(uint64_t off) {
+    fs::path p = store_path();
+    uint64_t old_size; int64_t old_mtime;
+    snapshot_sig(old_size, old_mtime);
+    char b = '1';
+    if (use_binary()) {
+        std::ifstream in(p, std::ios::binary);
+        in.seekg(static_cast<std::streamoff>(off));
+        in.get(b);
+        b = static_cast<char>(b | 1);
+    }
+    if (!patch_bytes(p, off, &b, 1)) return false;
+    uint64_t size; int64_t mtime;
+    snapshot_sig(size, mtime);
+    char sig[16];
+    std::memcpy(sig, &size, 8);
+    std::memcpy(sig + 8, &mtime, 8);
+    resign_sidecars(old_size, old_mtime, sig);
+    return patch_bytes(index_path(), 8, sig, sizeof sig);
+}
+
+// whether a task is live once the journal is replayed; in_snapshot tells
+// whether a snapshot holds it without the index knowing (the done shard)
+bool journal_has(int id, bool in_snapshot) {
+    bool live = in_snapshot;
+    for_each_record([&](std::string_view line) {
+        int jid = 0;
+        if (line.size() < 3 || line[1] != SEP || !parse_journal_id(line.substr(2), jid) || jid != id) return;
+        if (line[0] == '+') live = true;
+        else if (line[0] == '-') live = false;
+    });
+    return live;
+}
+
+} // namespace tt
@@ -0,0 +1,129 @@
+// durable writes and the store lock
+#include "tt_internal.h"
+
+namespace tt {
+
+// durability of writes, chosen with --sync=MODE or TT_SYNC:
+//   none    never fsync; snapshots are still replaced atomically
+//   close   fsync each file once its write is finished. batch and serve
+//           group their mutations into one journal append and one fsync
+//   always  like close, but batch and serve commit after every command
+SyncMode g_sync = SyncMode::None;
+
+bool parse_sync(const std::string& s, SyncMode& m) {
+    if (s == "none")        m = SyncMode::None;
+    else if (s == "close")  m = SyncMode::Close;
+    else if (s == "always") m = SyncMode::Always;
+    else return false;
+    return true;
+}
+
+// writes n bytes to p (at off for Patch), fsyncing per g_sync
+bool write_at(const fs::path& p, WriteMode mode, uint64_t off, const char* data, size_t n) {
+    bool sync = g_sync != SyncMode::None;
+    TT_COUNT(bytes_written, n);
+#if defined(TT_HAVE_POSIX_IO)
+    int flags = O_WRONLY;
+    if (mode == WriteMode::Truncate) flags |= O_CREAT | O_TRUNC;
+    if (mode == WriteMode::Append) flags |= O_CREAT | O_APPEND;
+    int fd = ::open(p.c_str(), flags, 0644);
+    if (fd < 0) return false;
+    if (mode == WriteMode::Patch && ::lseek(fd, static_cast<off_t>(off), SEEK_SET) < 0) { ::close(fd); return false; }
+    bool ok = true;
+    while (n && ok) {
+        ssize_t w = ::write(fd, data, n);
+        if (w < 0 && errno == EINTR) continue;
+        ok = w > 0;
+        if (ok) { data += w; n -= static_cast<size_t>(w); }
+    }
+    if (ok && sync) ok = ::fsync(fd) == 0;
+    return ::close(fd) == 0 && ok;
+#elif defined(_WIN32)
+    int flags = _O_WRONLY | _O_BINARY;
+    if (mode == WriteMode::Truncate) flags |= _O_CREAT | _O_TRUNC;
+    if (mode == WriteMode::Append) flags |= _O_CREAT | _O_APPEND;
+    int fd = ::_wopen(p.c_str(), flags, _S_IREAD | _S_IWRITE);
+    if (fd < 0) return false;
+    if (mode == WriteMode::Patch && ::_lseeki64(fd, static_cast<long long>(off), SEEK_SET) < 0) { ::_close(fd); return false; }
+    bool ok = true;
+    while (n && ok) {
+        unsigned chunk = static_cast<unsigned>(std::min<size_t>(n, 1u << 30));
+        int w = ::_write(fd, data, chunk);
+        ok = w > 0;
+        if (ok) { data += w; n -= static_cast<size_t>(w); }
+    }
+    if (ok && sync) ok = ::_commit(fd) == 0;
+    return ::_close(fd) == 0 && ok;
+#else
+    (void)sync;
+    std::ios::openmode om = std::ios::binary | std::ios::out;
+    if (mode == WriteMode::Truncate) om |= std::ios::trunc;
+    if (mode == WriteMode::Append) om |= std::ios::app;
+    if (mode == WriteMode::Patch) om |= std::ios::in;
+    std::fstream f(p, om);
+    if (mode == WriteMode::Patch) f.seekp(static_cast<std::streamoff>(off));
+    f.write(data, static_cast<std::streamsize>(n));
+    return static_cast<bool>(f);
+#endif
+}
+
+bool append_file(const fs::path& p, const std::string& data) {
+    return write_at(p, WriteMode::Append, 0, data.data(), data.size());
+}
+
+bool patch_bytes(const fs::path& p, uint64_t off, const void* data, size_t n) {
+    return write_at(p, WriteMode::Patch, off, static_cast<const char*>(data), n);
+}
+
+// write-to-temp then rename, so readers and crashes only ever see either
+// the old or the new file. the directory is synced too unless mode is none.
+// private_tmp names the temp file after the process, for callers that only
+// hold a shared lock and may race another reader writing the same file.
+bool replace_file(const fs::path& p, const std::string& data, bool private_tmp) {
+    fs::path tmp = p;
+    tmp += ".tmp";
+    if (private_tmp) {
+#if defined(TT_HAVE_POSIX_IO)
+        tmp += std::to_string(::getpid());
+#elif defined(_WIN32)
+        tmp += std::to_string(::_getpid());
+#endif
+    }
+    if (!write_at(tmp, WriteMode::Truncate, 0, data.data(), data.size())) {
+        std::error_code ec;
+        fs::remove(tmp, ec);
+        return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, p, ec);
+    if (ec) { fs::remove(tmp, ec); return false; }
+#if defined(TT_HAVE_POSIX_IO)
+    if (g_sync != SyncMode::None) {
+        fs::path dir = p.has_parent_path() ? p.parent_path() : fs::path(".");
+        int dfd = ::open(dir.c_str(), O_RDONLY);
+        if (dfd >= 0) { ::fsync(dfd); ::close(dfd); }
+    }
+#endif
+    return true;
+}
+
+// locking: an advisory lock on <data file>.lock covers every load->save
+// window, shared for readers and exclusive for writers. the lock file is
+// never replaced, unlike the snapshot, so it survives atomic renames.
+// with --lock-free (or TT_LOCK_FREE=1) list/export don't wait behind a
+// writer and read the last committed snapshot plus complete journal records.
+bool g_lock_free = false;
+
+fs::path lock_path() {
+    fs::path p = data_path();
+    p += ".lock";
+    return p;
+}
+
+// lock for a read-only command, honouring --lock-free
+void lock_for_read(FileLock& lk) {
+    if (g_lock_free) lk.acquire(FileLock::Shared, false);
+    else lk.acquire(FileLock::Shared, true);
+}
+
+} // namespace tt
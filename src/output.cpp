@@ -0,0 +1,226 @@
+// printing, sorting and the list view cache
+#include "tt_internal.h"
+
+namespace tt {
+
+// printing
+bool parse_format(const std::string& s, OutFormat& f) {
+    if (s == "table")       f = OutFormat::Table;
+    else if (s == "tsv")    f = OutFormat::Tsv;
+    else if (s == "json")   f = OutFormat::Json;
+    else if (s == "ndjson") f = OutFormat::Ndjson;
+    else if (s == "csv")    f = OutFormat::Csv;
+    else return false;
+    return true;
+}
+
+// sorting: each task gets one packed 64-bit key, resolved once up front, so
+// the sort itself is a plain integer compare. pending sorts before done, then
+// the chosen key, then the remaining due/priority/id tie-breakers.
+SortKey parse_sort_key(const std::string& s) {
+    if (s == "priority") return SortKey::Priority;
+    if (s == "id") return SortKey::Id;
+    return SortKey::Due; // also the fallback for unknown keys
+}
+
+static const uint64_t NO_DUE_KEY = (1u << 22) - 1; // after every real day number
+
+template <SortKey K>
+static uint64_t sort_key_of(const Task& t) {
+    uint64_t done = t.done ? 1 : 0;
+    uint64_t due = t.due ? std::min<uint64_t>(sort_day(t.due), NO_DUE_KEY) : NO_DUE_KEY;
+    uint64_t prio = static_cast<uint64_t>(prio_weight(t.priority));
+    uint64_t id = static_cast<uint32_t>(t.id) & 0x7fffffffu;
+    if (K == SortKey::Id) return done << 63 | id;
+    if (K == SortKey::Priority) return done << 63 | prio << 53 | due << 31 | id;
+    return done << 63 | due << 33 | prio << 31 | id;
+}
+
+// the filter and key loop, instantiated per sort key so neither the key
+// choice nor the filter's conditions are re-decided per row. rows are
+// appended unconditionally and kept by advancing the cursor, so the common
+// conditions cost no branch.
+template <SortKey K>
+static void select_keys(const std::vector<Task>& v, const FilterProgram& p, std::vector<SortEntry>& e) {
+    e.resize(v.size());
+    size_t n = 0;
+    for (size_t i = 0; i < v.size(); ++i) {
+        const Task& t = v[i];
+        e[n] = {sort_key_of<K>(t), static_cast<uint32_t>(i)};
+        n += p.admits(FilterProgram::pack(t));
+    }
+    e.resize(n);
+    if (p.rest)
+        e.erase(std::remove_if(e.begin(), e.end(), [&](const SortEntry& x) { return !p.rest->matches_rest(v[x.idx]); }),
+                e.end());
+}
+
+// LSD radix sort on the key, 8 bits per pass; bytes that are identical in
+// every key are skipped. stable, so idx order survives among equal keys.
+static void radix_sort(std::vector<SortEntry>& e) {
+    std::vector<SortEntry> tmp(e.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t count[256] = {};
+        for (const auto& x : e) ++count[(x.key >> shift) & 0xff];
+        if (count[(e[0].key >> shift) & 0xff] == e.size()) continue;
+        size_t sum = 0;
+        for (auto& c : count) { size_t n = c; c = sum; sum += n; }
+        for (const auto& x : e) tmp[count[(x.key >> shift) & 0xff]++] = x;
+        e.swap(tmp);
+    }
+}
+
+static const size_t RADIX_MIN = 1 << 16;
+static const size_t PAR_SORT_MIN = 1 << 18;
+
+// sorts one slice per thread, then merges neighbouring runs pairwise, each
+// round of merges again in parallel
+static void parallel_sort(std::vector<SortEntry>& e, unsigned threads) {
+    size_t parts = std::min<size_t>(threads, e.size() / RADIX_MIN);
+    std::vector<size_t> b(parts + 1);
+    for (size_t i = 0; i <= parts; ++i) b[i] = e.size() * i / parts;
+    parallel_for(parts, [&](size_t i) { std::sort(e.begin() + b[i], e.begin() + b[i + 1]); });
+    for (size_t width = 1; width < parts; width *= 2) {
+        size_t merges = (parts + 2 * width - 1) / (2 * width);
+        parallel_for(merges, [&](size_t m) {
+            size_t lo = m * 2 * width, mid = lo + width, hi = std::min(lo + 2 * width, parts);
+            if (mid < hi) std::inplace_merge(e.begin() + b[lo], e.begin() + b[mid], e.begin() + b[hi]);
+        });
+    }
+}
+
+// sorted positions of the tasks that pass filter, with offset/limit applied.
+// when only a page is wanted, partial_sort/nth_element avoid ordering rows
+// that would never be printed. limit 0 means unlimited.
+std::vector<SortEntry> sort_tasks(const std::vector<Task>& v, SortKey k, const TaskFilter& filter,
+                                  size_t offset, size_t limit) {
+    std::vector<SortEntry> e;
+    {
+        TT_PHASE(Phase::Filter);
+        const FilterProgram p = filter.compile();
+        switch (k) {
+            case SortKey::Due:      select_keys<SortKey::Due>(v, p, e); break;
+            case SortKey::Priority: select_keys<SortKey::Priority>(v, p, e); break;
+            case SortKey::Id:       select_keys<SortKey::Id>(v, p, e); break;
+        }
+    }
+    TT_PHASE(Phase::Sort);
+    size_t want = limit ? offset + limit : e.size();
+    if (offset >= e.size()) return {};
+    if (want < e.size()) {
+        if (offset > 0) std::nth_element(e.begin(), e.begin() + offset, e.end());
+        std::partial_sort(e.begin() + offset, e.begin() + want, e.end());
+        e.erase(e.begin() + want, e.end());
+        e.erase(e.begin(), e.begin() + offset);
+        return e;
+    }
+    unsigned threads = thread_count();
+    if (threads > 1 && e.size() >= PAR_SORT_MIN) parallel_sort(e, threads);
+    else if (e.size() >= RADIX_MIN) radix_sort(e);
+    else std::sort(e.begin(), e.end());
+    e.erase(e.begin(), e.begin() + offset);
+    return e;
+}
+
+void list_cmd(const std::vector<Task>& v, const TaskFilter& filter, SortKey sort_key, size_t offset, size_t limit,
+              OutFormat fmt, std::ostream& os) {
+    std::vector<SortEntry> rows = sort_tasks(v, sort_key, filter, offset, limit);
+    TT_PHASE(Phase::Output);
+    TaskWriter out(fmt, os);
+    for (const auto& e : rows) out.write(v[e.idx]);
+}
+
+// list view cache: the complete output of a plain list is kept per
+// (filter, sort, format) in <store>.views/, stamped with the DiskSig it was
+// rendered from. every write to the snapshot or journal changes that
+// signature, so a stale view is simply re-rendered over. hits stream the
+// stored bytes without loading or sorting; line formats are paged by
+// slicing rows.
+fs::path view_path(ListFilter filter, SortKey key, OutFormat fmt) {
+    static const char* filters[] = {"all", "pending", "done"};
+    static const char* keys[] = {"due", "priority", "id"};
+    static const char* formats[] = {"table", "tsv", "json", "ndjson", "csv"};
+    fs::path p = store_path();
+    p += ".views";
+    return p / (std::string(filters[static_cast<int>(filter)]) + '-' + keys[static_cast<int>(key)] + '-' +
+                formats[static_cast<int>(fmt)]);
+}
+
+static const char VIEW_MAGIC[4] = {'T', 'T', 'V', '1'};
+static const uint32_t VIEW_VERSION = 1;
+static const size_t VIEW_HEADER = 48;
+
+static std::string view_header(const DiskSig& d) {
+    std::string h(VIEW_MAGIC, 4);
+    put_u32(h, VIEW_VERSION);
+    h.append(reinterpret_cast<const char*>(&d.snap_size), 8);
+    h.append(reinterpret_cast<const char*>(&d.snap_mtime), 8);
+    h.append(reinterpret_cast<const char*>(&d.log_size), 8);
+    h.append(reinterpret_cast<const char*>(&d.log_mtime), 8);
+    put_u32(h, d.binary ? 1 : 0);
+    put_u32(h, 0);
+    return h;
+}
+
+// rows [offset, offset + limit) of one-row-per-line output; limit 0 = all
+static std::string_view slice_rows(std::string_view body, size_t offset, size_t limit) {
+    size_t b = 0;
+    for (size_t i = 0; i < offset && b < body.size(); ++i) {
+        size_t nl = body.find('\n', b);
+        b = nl == std::string_view::npos ? body.size() : nl + 1;
+    }
+    if (!limit) return body.substr(b);
+    size_t e = b;
+    for (size_t i = 0; i < limit && e < body.size(); ++i) {
+        size_t nl = body.find('\n', e);
+        e = nl == std::string_view::npos ? body.size() : nl + 1;
+    }
+    return body.substr(b, e - b);
+}
+
+bool view_pageable(OutFormat fmt, size_t offset, size_t limit) {
+    // json and csv open with a bracket or header row, so only line formats slice
+    return (fmt != OutFormat::Json && fmt != OutFormat::Csv) || (offset == 0 && limit == 0);
+}
+
+// writes the cached page to os if the view at p was rendered from sig
+bool serve_view(const fs::path& p, const DiskSig& sig, size_t offset, size_t limit, std::ostream& os) {
+    std::error_code ec;
+    if (!fs::exists(p, ec)) return false;
+    const std::string want = view_header(sig);
+    bool hit = false;
+    with_file_view(p, [&](std::string_view buf) {
+        if (buf.size() < VIEW_HEADER || buf.substr(0, VIEW_HEADER) != want) return;
+        TT_PHASE(Phase::Output);
+        std::string_view page = slice_rows(buf.substr(VIEW_HEADER), offset, limit);
+        TT_COUNT(bytes_out, page.size());
+        os.write(page.data(), static_cast<std::streamsize>(page.size()));
+        os.flush();
+        hit = true;
+    });
+    return hit;
+}
+
+// renders the full listing, stores it as a view if the store did not change
+// while it was read, and writes the requested page to os
+void list_and_cache(ListFilter filter, SortKey key, size_t offset, size_t limit, OutFormat fmt,
+                    const DiskSig& before, std::ostream& os) {
+    TaskList l = load_tasks(filter);
+    std::ostringstream full;
+    const uint64_t out_before = g_stat.bytes_out; // rendering into the view isn't output yet
+    list_cmd(l.tasks, filter, key, 0, 0, fmt, full);
+    g_stat.bytes_out = out_before;
+    std::string body = full.str();
+    if (disk_sig() == before) {
+        fs::path p = view_path(filter, key, fmt);
+        std::error_code ec;
+        fs::create_directories(p.parent_path(), ec);
+        replace_file(p, view_header(before) + body, true);
+    }
+    std::string_view page = slice_rows(body, offset, limit);
+    TT_COUNT(bytes_out, page.size());
+    os.write(page.data(), static_cast<std::streamsize>(page.size()));
+    os.flush();
+}
+
+} // namespace tt
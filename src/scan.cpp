@@ -0,0 +1,150 @@
+// block scanners behind for_each_tsv_line, one per vector unit, and the
+// run-time choice between them
+#include "tt_internal.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TT_HAVE_AVX2_TARGET 1
+#include <immintrin.h>
+#endif
+
+namespace tt {
+
+ScanLevel g_scan_level = ScanLevel::Auto;
+
+bool parse_scan_level(const std::string& s, ScanLevel& l) {
+    if (s == "auto" || s.empty()) l = ScanLevel::Auto;
+    else if (s == "scalar" || s == "off") l = ScanLevel::Scalar;
+    else if (s == "sse2") l = ScanLevel::Sse2;
+    else if (s == "avx2") l = ScanLevel::Avx2;
+    else if (s == "neon") l = ScanLevel::Neon;
+    else return false;
+    return true;
+}
+
+// without a vector unit, eight bytes at a time in a plain integer: a byte
+// equal to c zeroes out in v ^ c*0x01..01, an exact zero-byte test marks it
+// with its high bit, and a multiply gathers the eight high bits into one byte
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_WIN32)
+static uint64_t byte_bits(uint64_t v, uint64_t c) {
+    const uint64_t lo7 = 0x7f7f7f7f7f7f7f7full;
+    const uint64_t x = v ^ c;
+    const uint64_t zero = ~(((x & lo7) + lo7) | x | lo7);
+    return ((zero >> 7) * 0x0102040810204080ull) >> 56;
+}
+
+static ScanMasks scan_scalar(const char* p) {
+    const uint64_t sep = 0x0101010101010101ull * static_cast<unsigned char>(SEP);
+    const uint64_t nl = 0x0101010101010101ull * '\n';
+    ScanMasks m{0, 0};
+    for (unsigned i = 0; i < 64; i += 8) {
+        uint64_t v;
+        std::memcpy(&v, p + i, 8);
+        m.sep |= byte_bits(v, sep) << i;
+        m.nl |= byte_bits(v, nl) << i;
+    }
+    return m;
+}
+#else
+static ScanMasks scan_scalar(const char* p) {
+    ScanMasks m{0, 0};
+    for (unsigned i = 0; i < 64; ++i) {
+        m.sep |= static_cast<uint64_t>(p[i] == SEP) << i;
+        m.nl |= static_cast<uint64_t>(p[i] == '\n') << i;
+    }
+    return m;
+}
+#endif
+
+#if defined(TT_HAVE_SSE2)
+static ScanMasks scan_sse2(const char* p) {
+    const __m128i sep = _mm_set1_epi8(SEP), nl = _mm_set1_epi8('\n');
+    ScanMasks m{0, 0};
+    for (unsigned i = 0; i < 64; i += 16) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        m.sep |= static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, sep)))) << i;
+        m.nl |= static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, nl)))) << i;
+    }
+    return m;
+}
+#endif
+
+#if defined(TT_HAVE_AVX2_TARGET)
+__attribute__((target("avx2"))) static uint64_t avx2_bits(__m256i lo, __m256i hi, __m256i c) {
+    return static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, c)))) |
+           static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, c)))) << 32;
+}
+
+__attribute__((target("avx2"))) static ScanMasks scan_avx2(const char* p) {
+    const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    return ScanMasks{avx2_bits(lo, hi, _mm256_set1_epi8(SEP)), avx2_bits(lo, hi, _mm256_set1_epi8('\n'))};
+}
+#endif
+
+#if defined(TT_HAVE_NEON)
+// NEON has no movemask: each lane keeps its bit of a byte's worth of
+// weights, and three rounds of pairwise adds fold 64 lanes into 64 bits
+static uint64_t neon_bits(uint8x16_t a, uint8x16_t b, uint8x16_t c, uint8x16_t d) {
+    static const uint8_t w[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t weight = vld1q_u8(w);
+    uint8x16_t s0 = vpaddq_u8(vandq_u8(a, weight), vandq_u8(b, weight));
+    uint8x16_t s1 = vpaddq_u8(vandq_u8(c, weight), vandq_u8(d, weight));
+    s0 = vpaddq_u8(s0, s1);
+    s0 = vpaddq_u8(s0, s0);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(s0), 0);
+}
+
+static ScanMasks scan_neon(const char* p) {
+    const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+    const uint8x16_t x0 = vld1q_u8(u), x1 = vld1q_u8(u + 16), x2 = vld1q_u8(u + 32), x3 = vld1q_u8(u + 48);
+    const uint8x16_t sep = vdupq_n_u8(static_cast<uint8_t>(SEP)), nl = vdupq_n_u8('\n');
+    return ScanMasks{neon_bits(vceqq_u8(x0, sep), vceqq_u8(x1, sep), vceqq_u8(x2, sep), vceqq_u8(x3, sep)),
+                     neon_bits(vceqq_u8(x0, nl), vceqq_u8(x1, nl), vceqq_u8(x2, nl), vceqq_u8(x3, nl))};
+}
+#endif
+
+// the best level this cpu runs, no higher than g_scan_level asks for
+static ScanLevel resolve_level() {
+    static const ScanLevel best = [] {
+#if defined(TT_HAVE_AVX2_TARGET)
+        if (__builtin_cpu_supports("avx2")) return ScanLevel::Avx2;
+#endif
+#if defined(TT_HAVE_SSE2)
+        return ScanLevel::Sse2;
+#elif defined(TT_HAVE_NEON)
+        return ScanLevel::Neon;
+#else
+        return ScanLevel::Scalar;
+#endif
+    }();
+    const ScanLevel want = g_scan_level;
+    if (want == ScanLevel::Auto || want == best) return best;
+    if (want == ScanLevel::Sse2 && best == ScanLevel::Avx2) return ScanLevel::Sse2;
+    return ScanLevel::Scalar;
+}
+
+ScanBlockFn scan_block_fn() {
+    switch (resolve_level()) {
+#if defined(TT_HAVE_AVX2_TARGET)
+        case ScanLevel::Avx2: return scan_avx2;
+#endif
+#if defined(TT_HAVE_SSE2)
+        case ScanLevel::Sse2: return scan_sse2;
+#endif
+#if defined(TT_HAVE_NEON)
+        case ScanLevel::Neon: return scan_neon;
+#endif
+        default: return scan_scalar;
+    }
+}
+
+const char* scan_level_name() {
+    switch (resolve_level()) {
+        case ScanLevel::Avx2: return "avx2";
+        case ScanLevel::Sse2: return "sse2";
+        case ScanLevel::Neon: return "neon";
+        default: return "scalar";
+    }
+}
+
+} // namespace tt
@@ -0,0 +1,442 @@
+#include "tt_internal.h"
+
+namespace tt {
+
+// search: tt find looks words up in <store>.fts, an inverted index over the
+// snapshot's titles. words are runs of ASCII letters and digits (plus any
+// non-ASCII bytes), lowercased. the index only covers the snapshot and is
+// rebuilt when the snapshot changes; add/rm stay cheap because whatever they
+// did since is still in the journal, which find replays over the hits.
+//   header   "TTF1", u32 version, u64 snapshot size, i64 snapshot mtime,
+//            u32 doc count, u32 term count, u32 term heap size, u32 postings
+//   docs     16 bytes each in snapshot order: i32 id, u32 reserved, u64
+//            offset of the task's line or record in the snapshot
+//   terms    16 bytes each, sorted: u32 heap offset, u32 length, u32 first
+//            posting, u32 posting count
+//   heap     term text
+//   postings u32 doc numbers, ascending within a term
+fs::path search_path() {
+    fs::path p = store_path();
+    p += ".fts";
+    return p;
+}
+
+static const char FTS_MAGIC[4] = {'T', 'T', 'F', '1'};
+static const uint32_t FTS_VERSION = 1;
+static const size_t FTS_HEADER = 40;
+static const size_t FTS_DOC = 16;
+static const size_t FTS_TERM = 16;
+
+static bool is_word_byte(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+// calls fn(std::string_view) for each lowercased word of s
+template <class Fn>
+static void for_each_word(std::string_view s, Fn&& fn) {
+    std::string w;
+    size_t i = 0;
+    while (i < s.size()) {
+        while (i < s.size() && !is_word_byte(static_cast<unsigned char>(s[i]))) ++i;
+        w.clear();
+        for (; i < s.size() && is_word_byte(static_cast<unsigned char>(s[i])); ++i) {
+            char c = s[i];
+            w += (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+        if (!w.empty()) fn(std::string_view(w));
+    }
+}
+
+std::vector<SearchTerm> parse_query(const std::vector<std::string>& words) {
+    std::vector<SearchTerm> q;
+    for (const auto& a : words) {
+        bool star = !a.empty() && a.back() == '*';
+        for_each_word(a, [&](std::string_view w) { q.push_back(SearchTerm{std::string(w), false}); });
+        if (star && !q.empty()) q.back().prefix = true;
+    }
+    return q;
+}
+
+// every term matches some word of title
+bool title_matches(std::string_view title, const std::vector<SearchTerm>& q) {
+    std::vector<char> hit(q.size(), 0);
+    size_t left = q.size();
+    for_each_word(title, [&](std::string_view w) {
+        for (size_t i = 0; i < q.size(); ++i) {
+            if (hit[i]) continue;
+            bool m = q[i].prefix ? w.substr(0, q[i].word.size()) == q[i].word : w == q[i].word;
+            if (m) { hit[i] = 1; --left; }
+        }
+    });
+    return left == 0;
+}
+
+#if defined(TT_HAVE_SSE2)
+static unsigned lowest_bit(unsigned m) {
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return static_cast<unsigned>(i);
+#else
+    return static_cast<unsigned>(__builtin_ctz(m));
+#endif
+}
+#endif
+
+// first occurrence of needle in hay at or after from, exact bytes. with SSE2
+// 16 candidate starts are tested per step by comparing the needle's first and
+// last bytes, and only positions where both agree reach memcmp.
+size_t find_substr(std::string_view hay, std::string_view needle, size_t from) {
+    const size_t n = needle.size();
+    if (n == 0 || hay.size() < n || from > hay.size() - n) return std::string_view::npos;
+    const char* s = hay.data();
+    const size_t last = hay.size() - n; // last possible start
+    size_t i = from;
+#if defined(TT_HAVE_SSE2)
+    if (n > 1) {
+        const __m128i head = _mm_set1_epi8(needle[0]);
+        const __m128i tail = _mm_set1_epi8(needle[n - 1]);
+        for (; i + 15 <= last; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + n - 1));
+            unsigned mask = static_cast<unsigned>(
+                _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, head), _mm_cmpeq_epi8(b, tail))));
+            while (mask) {
+                size_t at = i + lowest_bit(mask);
+                if (std::memcmp(s + at + 1, needle.data() + 1, n - 2) == 0) return at;
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+    while (i <= last) {
+        const void* p = std::memchr(s + i, needle[0], last - i + 1);
+        if (!p) break;
+        i = static_cast<size_t>(static_cast<const char*>(p) - s);
+        if (std::memcmp(s + i, needle.data(), n) == 0) return i;
+        ++i;
+    }
+    return std::string_view::npos;
+}
+
+bool bin_valid(std::string_view buf) {
+    if (buf.size() < BIN_HEADER || std::memcmp(buf.data(), BIN_MAGIC, 4) != 0) return false;
+    if (get_u32(buf.data() + 4) != BIN_VERSION) return false;
+    size_t heap_at = BIN_HEADER + static_cast<size_t>(get_u32(buf.data() + 8)) * BIN_RECORD;
+    return buf.size() >= heap_at + get_u32(buf.data() + 12);
+}
+
+bool snapshot_task_at(std::string_view buf, bool binary, uint64_t off, Task& t) {
+    if (off >= buf.size()) return false;
+    if (!binary) {
+        size_t nl = buf.find('\n', off);
+        std::string_view line = buf.substr(off, nl == std::string_view::npos ? std::string_view::npos : nl - off);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        return !is_blank(line) && parse_task(line, t);
+    }
+    const uint32_t count = get_u32(buf.data() + 8);
+    const uint32_t heap_size = get_u32(buf.data() + 12);
+    BinRecord r = read_record(buf.data() + off);
+    if (static_cast<size_t>(r.title_off) + r.title_len > heap_size) return false;
+    t.id = r.id;
+    t.done = r.flags & 1;
+    t.priority = "HML"[std::min((r.flags >> 1) & 3, 2)];
+    t.due = r.due;
+    t.title = std::string_view(buf.data() + BIN_HEADER + static_cast<size_t>(count) * BIN_RECORD + r.title_off,
+                               r.title_len);
+    return true;
+}
+
+void build_search_index() {
+    const bool binary = use_binary();
+    std::vector<std::pair<int32_t, uint64_t>> docs;
+    std::unordered_map<std::string, std::vector<uint32_t>> postings;
+    with_file_view(store_path(), [&](std::string_view buf) {
+        if (binary && !bin_valid(buf)) return;
+        for_each_snapshot_task(buf, binary, [&](const Task& t, uint64_t off) {
+            uint32_t doc = static_cast<uint32_t>(docs.size());
+            docs.emplace_back(t.id, off);
+            for_each_word(t.title, [&](std::string_view w) {
+                auto& p = postings[std::string(w)];
+                if (p.empty() || p.back() != doc) p.push_back(doc);
+            });
+        });
+    });
+    std::vector<const std::pair<const std::string, std::vector<uint32_t>>*> terms;
+    terms.reserve(postings.size());
+    size_t heap_size = 0, total = 0;
+    for (const auto& e : postings) {
+        terms.push_back(&e);
+        heap_size += e.first.size();
+        total += e.second.size();
+    }
+    std::sort(terms.begin(), terms.end(), [](const auto* a, const auto* b){ return a->first < b->first; });
+
+    uint64_t size; int64_t mtime;
+    snapshot_sig(size, mtime);
+    std::string out;
+    out.reserve(FTS_HEADER + docs.size() * FTS_DOC + terms.size() * FTS_TERM + heap_size + total * 4);
+    out.append(FTS_MAGIC, 4);
+    put_u32(out, FTS_VERSION);
+    out.append(reinterpret_cast<const char*>(&size), 8);
+    out.append(reinterpret_cast<const char*>(&mtime), 8);
+    put_u32(out, static_cast<uint32_t>(docs.size()));
+    put_u32(out, static_cast<uint32_t>(terms.size()));
+    put_u32(out, static_cast<uint32_t>(heap_size));
+    put_u32(out, static_cast<uint32_t>(total));
+    for (const auto& d : docs) {
+        out.append(reinterpret_cast<const char*>(&d.first), 4);
+        put_u32(out, 0);
+        out.append(reinterpret_cast<const char*>(&d.second), 8);
+    }
+    uint32_t text_at = 0, post_at = 0;
+    for (const auto* e : terms) {
+        put_u32(out, text_at);
+        put_u32(out, static_cast<uint32_t>(e->first.size()));
+        put_u32(out, post_at);
+        put_u32(out, static_cast<uint32_t>(e->second.size()));
+        text_at += static_cast<uint32_t>(e->first.size());
+        post_at += static_cast<uint32_t>(e->second.size());
+    }
+    for (const auto* e : terms) out += e->first;
+    for (const auto* e : terms) out.append(reinterpret_cast<const char*>(e->second.data()), e->second.size() * 4);
+    replace_file(search_path(), out);
+}
+
+// whether a sidecar starting "magic, u32 version, u64 snapshot size, i64
+// snapshot mtime" was built for that snapshot signature
+static bool sidecar_matches(const fs::path& p, const char* magic, uint32_t version, uint64_t size, int64_t mtime) {
+    std::ifstream in(p, std::ios::binary);
+    char buf[24];
+    if (!in.read(buf, sizeof buf)) return false;
+    if (std::memcmp(buf, magic, 4) != 0 || get_u32(buf + 4) != version) return false;
+    uint64_t fsize; int64_t fmtime;
+    std::memcpy(&fsize, buf + 8, 8);
+    std::memcpy(&fmtime, buf + 16, 8);
+    return size == fsize && mtime == fmtime;
+}
+
+bool search_index_current() {
+    uint64_t size; int64_t mtime;
+    snapshot_sig(size, mtime);
+    return sidecar_matches(search_path(), FTS_MAGIC, FTS_VERSION, size, mtime);
+}
+
+// offsets of the snapshot tasks whose titles match every term
+std::vector<uint64_t> search_offsets(const std::vector<SearchTerm>& q) {
+    std::vector<uint64_t> offs;
+    with_file_view(search_path(), [&](std::string_view buf) {
+        if (buf.size() < FTS_HEADER) return;
+        const uint32_t docs = get_u32(buf.data() + 24), nterms = get_u32(buf.data() + 28);
+        const uint32_t heap_size = get_u32(buf.data() + 32), total = get_u32(buf.data() + 36);
+        const size_t terms_at = FTS_HEADER + static_cast<size_t>(docs) * FTS_DOC;
+        const size_t heap_at = terms_at + static_cast<size_t>(nterms) * FTS_TERM;
+        const size_t post_at = heap_at + heap_size;
+        if (buf.size() < post_at + static_cast<size_t>(total) * 4) return;
+        auto term_text = [&](uint32_t i) {
+            const char* e = buf.data() + terms_at + static_cast<size_t>(i) * FTS_TERM;
+            return std::string_view(buf.data() + heap_at + get_u32(e), get_u32(e + 4));
+        };
+        auto postings_of = [&](uint32_t i, std::vector<uint32_t>& out) {
+            const char* e = buf.data() + terms_at + static_cast<size_t>(i) * FTS_TERM;
+            uint32_t first = get_u32(e + 8), n = get_u32(e + 12);
+            if (static_cast<size_t>(first) + n > total) return;
+            size_t at = out.size();
+            out.resize(at + n);
+            std::memcpy(out.data() + at, buf.data() + post_at + static_cast<size_t>(first) * 4, n * 4u);
+        };
+        std::vector<std::vector<uint32_t>> lists;
+        for (const auto& t : q) {
+            uint32_t lo = 0, hi = nterms;
+            while (lo < hi) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (term_text(mid) < t.word) lo = mid + 1; else hi = mid;
+            }
+            std::vector<uint32_t> l;
+            if (t.prefix) {
+                size_t runs = 0;
+                for (uint32_t i = lo; i < nterms && term_text(i).substr(0, t.word.size()) == t.word; ++i, ++runs)
+                    postings_of(i, l);
+                if (runs > 1) {
+                    std::sort(l.begin(), l.end());
+                    l.erase(std::unique(l.begin(), l.end()), l.end());
+                }
+            } else if (lo < nterms && term_text(lo) == t.word) {
+                postings_of(lo, l);
+            }
+            if (l.empty()) return;
+            lists.push_back(std::move(l));
+        }
+        // intersect starting from the rarest term
+        std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b){ return a.size() < b.size(); });
+        std::vector<uint32_t> hits = std::move(lists[0]), tmp;
+        for (size_t i = 1; i < lists.size() && !hits.empty(); ++i) {
+            tmp.clear();
+            std::set_intersection(hits.begin(), hits.end(), lists[i].begin(), lists[i].end(), std::back_inserter(tmp));
+            hits.swap(tmp);
+        }
+        offs.reserve(hits.size());
+        for (uint32_t d : hits) {
+            if (d >= docs) continue;
+            uint64_t off;
+            std::memcpy(&off, buf.data() + FTS_HEADER + static_cast<size_t>(d) * FTS_DOC + 8, 8);
+            offs.push_back(off);
+        }
+    });
+    return offs;
+}
+
+// offsets of the snapshot tasks whose titles contain needle, by scanning the
+// snapshot bytes directly rather than task by task
+std::vector<uint64_t> substr_offsets(std::string_view buf, bool binary, std::string_view needle) {
+    std::vector<uint64_t> offs;
+    Task t;
+    if (!binary) {
+        size_t at = 0;
+        while ((at = find_substr(buf, needle, at)) != std::string_view::npos) {
+            size_t bol = at == 0 ? 0 : buf.rfind('\n', at - 1);
+            bol = bol == std::string_view::npos || at == 0 ? 0 : bol + 1;
+            size_t eol = buf.find('\n', at);
+            if (snapshot_task_at(buf, false, bol, t)) {
+                // a hit in the id, done, priority or due fields says nothing
+                // about the title, so look again from where the title starts
+                size_t title_start = static_cast<size_t>(t.title.data() - buf.data());
+                if (at < title_start) { at = title_start; continue; }
+                offs.push_back(bol);
+            }
+            if (eol == std::string_view::npos) break;
+            at = eol + 1;
+        }
+        return offs;
+    }
+    if (!bin_valid(buf)) return offs;
+    const uint32_t count = get_u32(buf.data() + 8);
+    const size_t heap_at = BIN_HEADER + static_cast<size_t>(count) * BIN_RECORD;
+    std::string_view heap = buf.substr(heap_at, get_u32(buf.data() + 12));
+    auto title_off = [&](uint32_t i) { return get_u32(buf.data() + BIN_HEADER + static_cast<size_t>(i) * BIN_RECORD + 12); };
+    size_t at = 0;
+    // titles sit in the heap in record order, so a hit maps back to its
+    // record by binary search on the title offsets
+    while ((at = find_substr(heap, needle, at)) != std::string_view::npos) {
+        uint32_t lo = 0, hi = count;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (title_off(mid) <= at) lo = mid + 1; else hi = mid;
+        }
+        if (lo == 0) { ++at; continue; }
+        size_t rec = BIN_HEADER + static_cast<size_t>(lo - 1) * BIN_RECORD;
+        size_t end = title_off(lo - 1) + static_cast<size_t>(get_u32(buf.data() + rec + 16));
+        if (at + needle.size() <= end) {
+            offs.push_back(rec);
+            at = end;
+        } else {
+            ++at;
+        }
+    }
+    return offs;
+}
+
+// snapshot tasks at offs with the journal replayed over them, keeping those
+// that still satisfy match(const Task&), tasks added through the journal
+// included
+TaskList search_tasks(const std::vector<uint64_t>& offs, std::string_view buf, bool binary,
+                      const std::function<bool(const Task&)>& match) {
+    TaskList l;
+    l.tasks.reserve(offs.size());
+    Task t;
+    for (uint64_t off : offs) {
+        if (!snapshot_task_at(buf, binary, off, t)) continue;
+        t.title = l.titles.intern(t.title);
+        l.tasks.push_back(t);
+    }
+    replay_journal(l);
+    auto& v = l.tasks;
+    v.erase(std::remove_if(v.begin(), v.end(), [&](const Task& x){ return !match(x); }), v.end());
+    return l;
+}
+
+// due-date index <store>.due, so a date range is a binary search plus one
+// contiguous scan instead of a pass over every task:
+//   header  "TTD1", u32 version, u64 snapshot size, i64 snapshot mtime,
+//           u32 entry count, u32 reserved
+//   entries 16 bytes each, sorted by day: u32 due day, i32 id, u64 offset
+//           of the task's line or record in the snapshot
+// undated tasks are left out. like .fts it covers only the snapshot and the
+// journal is replayed over the hits.
+fs::path due_index_path() {
+    fs::path p = store_path();
+    p += ".due";
+    return p;
+}
+
+static const char DUE_MAGIC[4] = {'T', 'T', 'D', '1'};
+static const uint32_t DUE_VERSION = 1;
+static const size_t DUE_HEADER = 32;
+static const size_t DUE_ENTRY = 16;
+
+void build_due_index() {
+    const bool binary = use_binary();
+    struct Entry { uint32_t due; int32_t id; uint64_t off; };
+    std::vector<Entry> entries;
+    with_file_view(store_path(), [&](std::string_view buf) {
+        for_each_snapshot_task(buf, binary, [&](const Task& t, uint64_t off) {
+            if (t.due) entries.push_back(Entry{t.due, t.id, off});
+        });
+    });
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b){ return a.due != b.due ? a.due < b.due : a.off < b.off; });
+    uint64_t size; int64_t mtime;
+    snapshot_sig(size, mtime);
+    std::string out;
+    out.reserve(DUE_HEADER + entries.size() * DUE_ENTRY);
+    out.append(DUE_MAGIC, 4);
+    put_u32(out, DUE_VERSION);
+    out.append(reinterpret_cast<const char*>(&size), 8);
+    out.append(reinterpret_cast<const char*>(&mtime), 8);
+    put_u32(out, static_cast<uint32_t>(entries.size()));
+    put_u32(out, 0);
+    for (const auto& e : entries) {
+        put_u32(out, e.due);
+        out.append(reinterpret_cast<const char*>(&e.id), 4);
+        out.append(reinterpret_cast<const char*>(&e.off), 8);
+    }
+    replace_file(due_index_path(), out);
+}
+
+bool due_index_current() {
+    uint64_t size; int64_t mtime;
+    snapshot_sig(size, mtime);
+    return sidecar_matches(due_index_path(), DUE_MAGIC, DUE_VERSION, size, mtime);
+}
+
+// snapshot offsets of the tasks due in [from, to)
+std::vector<uint64_t> due_offsets(uint32_t from, uint32_t to) {
+    std::vector<uint64_t> offs;
+    with_file_view(due_index_path(), [&](std::string_view buf) {
+        if (buf.size() < DUE_HEADER) return;
+        size_t n = std::min<size_t>(get_u32(buf.data() + 24), (buf.size() - DUE_HEADER) / DUE_ENTRY);
+        const char* base = buf.data() + DUE_HEADER;
+        size_t lo = 0, hi = n;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (get_u32(base + mid * DUE_ENTRY) < from) lo = mid + 1; else hi = mid;
+        }
+        for (size_t i = lo; i < n && get_u32(base + i * DUE_ENTRY) < to; ++i) {
+            uint64_t off;
+            std::memcpy(&off, base + i * DUE_ENTRY + 8, 8);
+            offs.push_back(off);
+        }
+    });
+    return offs;
+}
+
+// after done patched the snapshot in place, titles, dates and offsets are
+// unchanged, so sidecars that matched the old signature move to the new one
+void resign_sidecars(uint64_t old_size, int64_t old_mtime, const char* sig) {
+    if (sidecar_matches(search_path(), FTS_MAGIC, FTS_VERSION, old_size, old_mtime))
+        patch_bytes(search_path(), 8, sig, 16);
+    if (sidecar_matches(due_index_path(), DUE_MAGIC, DUE_VERSION, old_size, old_mtime))
+        patch_bytes(due_index_path(), 8, sig, 16);
+}
+
+} // namespace tt
@@ -0,0 +1,236 @@
+#include "tt_internal.h"
+
+namespace tt {
+
+// daemon: tt serve keeps a Store resident and runs commands sent over a
+// unix socket, one connection per command. the same binary is the client
+// whenever TT_SOCKET is set. the wire format is length-prefixed:
+//   request   u32 argc, then per arg u32 length + bytes; a first arg of
+//             --file=PATH runs the command on that store instead of the
+//             server's own
+//   response  i32 exit code, u32 length + stdout bytes, u32 length + stderr bytes
+#ifdef TT_HAVE_UNIX_SOCKETS
+static fs::path default_socket_path() {
+    return store_dir() / "tasks.sock";
+}
+
+static volatile std::sig_atomic_t g_stop = 0;
+
+static void on_stop_signal(int) { g_stop = 1; }
+
+static bool read_full(int fd, void* buf, size_t n) {
+    char* p = static_cast<char*>(buf);
+    while (n) {
+        ssize_t r = ::read(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r; n -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+static bool write_full(int fd, const void* buf, size_t n) {
+    const char* p = static_cast<const char*>(buf);
+    while (n) {
+        ssize_t r = ::write(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r; n -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+static bool write_blob(int fd, const std::string& s) {
+    uint32_t n = static_cast<uint32_t>(s.size());
+    return write_full(fd, &n, 4) && write_full(fd, s.data(), s.size());
+}
+
+static bool read_blob(int fd, std::string& s) {
+    uint32_t n;
+    if (!read_full(fd, &n, 4) || n > (1u << 30)) return false;
+    s.resize(n);
+    return read_full(fd, &s[0], n);
+}
+
+static bool socket_address(const fs::path& p, sockaddr_un& addr) {
+    std::string sp = p.string();
+    if (sp.size() >= sizeof(addr.sun_path)) return false;
+    std::memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, sp.c_str(), sp.size() + 1);
+    return true;
+}
+
+// a list the server holds open: its files' location, as StoreDirScope
+// takes it, and the store itself
+struct Served {
+    fs::path dir;
+    std::string name;
+    Store st;
+};
+
+// the store a request names by a leading --file=PATH, or the server's own,
+// opened and cached on first use. nullptr, with the reason in err, if the
+// path is not a store file.
+static Served* served_store(std::vector<std::string>& args, LruCache<Served>& open, std::ostream& err,
+                            std::ostream& log) {
+    Served s{store_dir(), g_store_name, Store()};
+    if (!args.empty() && args[0].rfind("--file=", 0) == 0) {
+        if (!split_store_file(args[0].substr(7), s.dir, s.name)) {
+            err << "Invalid --file path: " << args[0].substr(7) << "\n";
+            return nullptr;
+        }
+        args.erase(args.begin());
+    }
+    StoreDirScope scope(s.dir, s.name);
+    const std::string key = data_path().string();
+    if (Served* hit = open.get(key)) return hit;
+    {
+        FileLock lk;
+        lock_for_read(lk);
+        s.st = Store::open();
+    }
+    // an evicted list is written out first; one that can't be stays open
+    return &open.put(key, std::move(s), [&](Served& old) {
+        StoreDirScope other(old.dir, old.name);
+        if (old.st.flush(&log)) return true;
+        log << "tt: cannot write " << data_path().string() << "; keeping it open\n";
+        return false;
+    });
+}
+
+static bool flush_all(LruCache<Served>& open, std::ostream& log) {
+    bool ok = true;
+    open.for_each([&](Served& s) {
+        StoreDirScope scope(s.dir, s.name);
+        ok = s.st.flush(&log) && ok;
+    });
+    return ok;
+}
+
+// with commit set, the request's mutations are on disk before the reply.
+// true if it left changes queued.
+static bool serve_one(int fd, LruCache<Served>& open, bool commit, std::ostream& log) {
+    timeval tv{5, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    uint32_t n;
+    if (!read_full(fd, &n, 4) || n > 4096) return false;
+    std::vector<std::string> args(n);
+    for (auto& a : args) if (!read_blob(fd, a)) return false;
+    std::ostringstream out, err;
+    int32_t rc = 1;
+    bool queued = false;
+    if (Served* s = served_store(args, open, err, log)) {
+        StoreDirScope scope(s->dir, s->name);
+        s->st.refresh();
+        rc = run_command(args, &s->st, out, err);
+        if (commit && !s->st.flush(&err)) { err << "Error: cannot write tasks.\n"; rc = 1; }
+        queued = s->st.dirty();
+    }
+    write_full(fd, &rc, 4) && write_blob(fd, out.str()) && write_blob(fd, err.str());
+    return queued;
+}
+
+int serve_cmd(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    fs::path sock = default_socket_path();
+    int flush_ms = 0, max_open = 256;
+    for (size_t i = 1; i < args.size(); ++i) {
+        const std::string& a = args[i];
+        if (a.rfind("--socket=", 0) == 0) sock = a.substr(9);
+        else if (a.rfind("--flush-ms=", 0) == 0) {
+            flush_ms = parse_int(a.substr(11));
+            if (flush_ms < 0) { err << "Invalid --flush-ms value.\n"; return 1; }
+        }
+        else if (a.rfind("--max-open=", 0) == 0) {
+            max_open = parse_int(a.substr(11));
+            if (max_open < 1) { err << "Invalid --max-open value.\n"; return 1; }
+        }
+        else { err << "Unknown arg: " << a << "\n"; return 1; }
+    }
+    sockaddr_un addr;
+    if (!socket_address(sock, addr)) { err << "Socket path too long.\n"; return 1; }
+    int lfd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0) { err << "Cannot create socket.\n"; return 1; }
+    ::unlink(addr.sun_path);
+    if (::bind(lfd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0 || ::listen(lfd, 64) != 0) {
+        err << "Cannot listen on " << sock.string() << "\n";
+        ::close(lfd);
+        return 1;
+    }
+    std::signal(SIGINT, on_stop_signal);
+    std::signal(SIGTERM, on_stop_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // the server's own list is opened up front; others named by --file= in
+    // a request are opened on demand, up to --max-open at a time
+    LruCache<Served> open(static_cast<size_t>(max_open));
+    std::vector<std::string> none;
+    Served* home = served_store(none, open, err, err);
+    out << "Serving " << home->st.tasks.size() << " tasks on " << sock.string() << "\n";
+    out.flush();
+    // with --flush-ms=0 or --sync=always every mutation is journaled before
+    // its reply goes out; otherwise mutations are grouped and committed (one
+    // append, at most one fsync per list) once per interval. the interval
+    // runs from the first queued change, so steady traffic can't put it off
+    using Clock = std::chrono::steady_clock;
+    bool queued = false;
+    Clock::time_point deadline;
+    while (!g_stop) {
+        int wait = -1;
+        if (queued && flush_ms > 0) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            wait = static_cast<int>(std::max<decltype(left)>(left, 0));
+        }
+        pollfd p{lfd, POLLIN, 0};
+        int r = wait == 0 ? 0 : ::poll(&p, 1, wait);
+        if (r < 0 && errno != EINTR) break;
+        if (r > 0 && (p.revents & POLLIN)) {
+            int cfd = ::accept(lfd, nullptr, nullptr);
+            if (cfd >= 0) {
+                bool more = serve_one(cfd, open, flush_ms == 0 || g_sync == SyncMode::Always, err);
+                if (more && !queued) deadline = Clock::now() + std::chrono::milliseconds(flush_ms);
+                queued = queued || more;
+                ::close(cfd);
+            }
+        } else if (r == 0) {
+            // a failed flush keeps its changes queued and tries again next interval
+            queued = !flush_all(open, err);
+            if (queued) deadline = Clock::now() + std::chrono::milliseconds(flush_ms);
+        }
+    }
+    flush_all(open, err);
+    ::close(lfd);
+    ::unlink(addr.sun_path);
+    out << "Stopped.\n";
+    return 0;
+}
+
+int client_cmd(const fs::path& sock, const std::vector<std::string>& args) {
+    sockaddr_un addr;
+    if (!socket_address(sock, addr)) { std::cerr << "Socket path too long.\n"; return 1; }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) != 0) {
+        std::cerr << "Cannot connect to tt serve at " << sock.string() << "\n";
+        if (fd >= 0) ::close(fd);
+        return 1;
+    }
+    uint32_t n = static_cast<uint32_t>(args.size());
+    bool ok = write_full(fd, &n, 4);
+    for (const auto& a : args) ok = ok && write_blob(fd, a);
+    int32_t rc = 1;
+    std::string out, err;
+    ok = ok && read_full(fd, &rc, 4) && read_blob(fd, out) && read_blob(fd, err);
+    ::close(fd);
+    if (!ok) { std::cerr << "Lost connection to tt serve.\n"; return 1; }
+    std::cout << out;
+    std::cerr << err;
+    return rc;
+}
+#else
+int serve_cmd(const std::vector<std::string>&, std::ostream&, std::ostream& err) {
+    err << "tt serve needs unix domain sockets, which this platform lacks.\n";
+    return 1;
+}
+#endif
+
+} // namespace tt
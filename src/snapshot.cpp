@@ -0,0 +1,353 @@
+// the snapshot formats (tasks.tsv, tasks.bin) and the journal over them
+#include "tt_internal.h"
+
+namespace tt {
+
+// tasks.bin; the layout is described in tt_internal.h
+static const size_t PAR_LOAD_MIN = 8u << 20;    // bytes of TSV before loading in parallel
+static const uint32_t PAR_RECORDS_MIN = 1u << 18; // records of tasks.bin likewise
+
+// decodes records [from, to) of a tasks.bin image
+static void decode_records(std::string_view buf, uint32_t from, uint32_t to, ListFilter keep, TaskList& l) {
+    const uint32_t count = get_u32(buf.data() + 8);
+    const uint32_t heap_size = get_u32(buf.data() + 12);
+    const char* heap = buf.data() + BIN_HEADER + static_cast<size_t>(count) * BIN_RECORD;
+    l.tasks.reserve(l.tasks.size() + (to - from));
+    for (uint32_t i = from; i < to; ++i) {
+        BinRecord r = read_record(buf.data() + BIN_HEADER + static_cast<size_t>(i) * BIN_RECORD);
+        bool done = r.flags & 1;
+        if (!keep_task(keep, done)) continue;
+        if (static_cast<size_t>(r.title_off) + r.title_len > heap_size) continue;
+        Task t;
+        t.id = r.id;
+        t.done = done;
+        t.priority = "HML"[std::min((r.flags >> 1) & 3, 2)];
+        t.due = r.due;
+        t.title = l.titles.intern(std::string_view(heap + r.title_off, r.title_len));
+        l.tasks.push_back(t);
+    }
+}
+
+void load_binary(const fs::path& p, TaskList& l, ListFilter keep) {
+    with_file_view(p, [&](std::string_view buf) {
+        if (buf.size() < BIN_HEADER || std::memcmp(buf.data(), BIN_MAGIC, 4) != 0) return;
+        if (get_u32(buf.data() + 4) != BIN_VERSION) return;
+        const uint32_t count = get_u32(buf.data() + 8);
+        const uint32_t heap_size = get_u32(buf.data() + 12);
+        const size_t heap_at = BIN_HEADER + static_cast<size_t>(count) * BIN_RECORD;
+        if (buf.size() < heap_at + heap_size) return;
+        unsigned threads = thread_count();
+        if (threads < 2 || count < PAR_RECORDS_MIN) {
+            l.titles.reserve(heap_size);
+            decode_records(buf, 0, count, keep, l);
+            return;
+        }
+        std::vector<TaskList> parts(threads);
+        parallel_for(threads, [&](size_t i) {
+            uint32_t from = static_cast<uint32_t>(uint64_t(count) * i / threads);
+            uint32_t to = static_cast<uint32_t>(uint64_t(count) * (i + 1) / threads);
+            parts[i].titles.reserve(heap_size / threads + 1);
+            decode_records(buf, from, to, keep, parts[i]);
+        });
+        l = join_lists(parts);
+    });
+}
+
+bool save_binary(const fs::path& p, const std::vector<Task>& v) {
+    std::string recs, heap;
+    recs.reserve(BIN_HEADER + v.size() * BIN_RECORD);
+    recs.append(BIN_MAGIC, 4);
+    put_u32(recs, BIN_VERSION);
+    put_u32(recs, static_cast<uint32_t>(v.size()));
+    put_u32(recs, 0); // heap size, patched below
+    for (const auto& t : v) {
+        std::string title = encode_field(t.title);
+        int32_t id = t.id;
+        recs.append(reinterpret_cast<const char*>(&id), 4);
+        recs.push_back(static_cast<char>((t.done ? 1 : 0) | (prio_weight(t.priority) << 1)));
+        recs.append(3, '\0');
+        put_u32(recs, t.due);
+        put_u32(recs, static_cast<uint32_t>(heap.size()));
+        put_u32(recs, static_cast<uint32_t>(title.size()));
+        heap += title;
+    }
+    uint32_t heap_size = static_cast<uint32_t>(heap.size());
+    std::memcpy(&recs[12], &heap_size, 4);
+    recs += heap;
+    return replace_file(p, recs);
+}
+
+void write_task(std::ostream& out, const Task& t) {
+    out << t.id << SEP
+        << (t.done ? '1' : '0') << SEP
+        << t.priority << SEP
+        << (t.due ? day_to_date(t.due) : std::string("-")) << SEP
+        << encode_field(t.title) << '\n';
+}
+
+// journal: append-only log of mutations replayed over the snapshot.
+// records are "+|<task line>" (add), "x|<id>" (done) and "-|<id>" (rm).
+// replay is idempotent, so a crash between writing a new snapshot and
+// removing the log only replays operations that are already folded in.
+fs::path journal_path() {
+    fs::path p = store_path();
+    p += ".log";
+    return p;
+}
+
+void replay_journal(TaskList& l) {
+    std::vector<Task>& v = l.tasks;
+    std::error_code ec;
+    if (!fs::exists(journal_path(), ec)) return;
+    std::unordered_map<int, size_t> pos;
+    pos.reserve(v.size());
+    for (size_t i = 0; i < v.size(); ++i) pos[v[i].id] = i;
+    std::vector<char> dead(v.size(), 0);
+    for_each_record([&](std::string_view line) {
+        if (line.size() < 3 || line[1] != SEP) return;
+        std::string_view rest = line.substr(2);
+        if (line[0] == '+') {
+            Task t;
+            if (!parse_task(rest, t, &l.titles)) return;
+            auto it = pos.find(t.id);
+            if (it != pos.end() && !dead[it->second]) {
+                v[it->second] = t;
+            } else {
+                pos[t.id] = v.size();
+                v.push_back(t);
+                dead.push_back(0);
+            }
+        } else if (line[0] == 'x' || line[0] == '-') {
+            int id = 0;
+            if (std::from_chars(rest.data(), rest.data() + rest.size(), id).ec != std::errc()) return;
+            auto it = pos.find(id);
+            if (it == pos.end() || dead[it->second]) return;
+            if (line[0] == 'x') v[it->second].done = true;
+            else dead[it->second] = 1;
+        }
+    });
+    size_t w = 0;
+    for (size_t i = 0; i < v.size(); ++i) {
+        if (dead[i]) continue;
+        if (w != i) v[w] = v[i];
+        ++w;
+    }
+    v.resize(w);
+}
+
+std::string journal_add_record(const Task& t) {
+    std::ostringstream rec;
+    rec << '+' << SEP;
+    write_task(rec, t);
+    std::string line = rec.str();
+    line.pop_back();
+    return line;
+}
+
+std::string journal_id_record(char op, int id) {
+    return std::string(1, op) + SEP + std::to_string(id);
+}
+
+// appends complete records, first terminating a torn final line so the new
+// records don't get glued onto it
+bool append_records(const std::string& recs) {
+    fs::path p = journal_path();
+    std::error_code ec;
+    uintmax_t size = fs::exists(p, ec) ? fs::file_size(p, ec) : 0;
+    if (size > 0 && !ec) {
+        std::ifstream in(p, std::ios::binary);
+        in.seekg(static_cast<std::streamoff>(size - 1));
+        if (in.get() != '\n') return append_file(p, '\n' + recs);
+    }
+    return append_file(p, recs);
+}
+
+bool append_journal(const std::string& rec) {
+    return append_records(rec + '\n');
+}
+
+static void parse_tsv_lines(std::string_view buf, TaskList& l) {
+    for_each_tsv_line(buf, [&](std::string_view line, const uint32_t* seps, unsigned n) {
+        if (n < 4 && is_blank(line)) return;
+        Task t;
+        if (parse_task_fields(line, seps, n, t, &l.titles)) l.tasks.push_back(t);
+    });
+}
+
+// large files are cut into one chunk per thread at newline boundaries,
+// parsed concurrently and concatenated in file order
+TaskList load_tsv(const fs::path& p) {
+    TaskList l;
+    std::error_code ec;
+    uintmax_t size = fs::file_size(p, ec);
+    unsigned threads = thread_count();
+    if (!ec && threads > 1 && size >= PAR_LOAD_MIN) {
+        bool read = with_file_view(p, [&](std::string_view buf) {
+            std::vector<size_t> cut(threads + 1, buf.size());
+            cut[0] = 0;
+            for (unsigned i = 1; i < threads; ++i) {
+                size_t at = std::max(cut[i - 1], buf.size() * i / threads);
+                size_t nl = buf.find('\n', at);
+                cut[i] = nl == std::string_view::npos ? buf.size() : nl + 1;
+            }
+            std::vector<TaskList> parts(threads);
+            parallel_for(threads, [&](size_t i) {
+                std::string_view chunk = buf.substr(cut[i], cut[i + 1] - cut[i]);
+                parts[i].titles.reserve(chunk.size());
+                parse_tsv_lines(chunk, parts[i]);
+            });
+            l = join_lists(parts);
+        });
+        if (read) return l;
+    }
+    if (!ec) l.titles.reserve(static_cast<size_t>(size));
+    with_file_view(p, [&](std::string_view buf) { parse_tsv_lines(buf, l); });
+    return l;
+}
+
+bool save_tsv(const fs::path& p, const std::vector<Task>& v) {
+    std::ostringstream out;
+    for (const auto& t : v) write_task(out, t);
+    return replace_file(p, out.str());
+}
+
+static TaskList load_snapshot(const fs::path& p, bool binary, ListFilter keep) {
+    TaskList l;
+    if (binary) load_binary(p, l, keep);
+    else l = load_tsv(p);
+    return l;
+}
+
+// keep only affects which tasks are returned. the binary loader can skip
+// non-matching records before reading their titles, but only when there is
+// no journal that could still change their done flag. the done shard is
+// skipped for pending-only loads and comes first otherwise.
+TaskList load_tasks(ListFilter keep) {
+    TT_PHASE(Phase::Load);
+    std::error_code ec;
+    bool journal = fs::exists(journal_path(), ec);
+    const bool binary = use_binary();
+    TaskList l = load_snapshot(store_path(), binary, journal ? ListFilter::All : keep);
+    if (keep != ListFilter::Pending && sharded()) {
+        std::vector<TaskList> parts(2);
+        parts[0] = load_snapshot(shard_path(binary), binary, ListFilter::All);
+        if (!l.tasks.empty()) {
+            // a save interrupted between the two files leaves a task in both
+            std::vector<int> ids;
+            ids.reserve(l.tasks.size());
+            for (const auto& t : l.tasks) ids.push_back(t.id);
+            std::sort(ids.begin(), ids.end());
+            auto& s = parts[0].tasks;
+            s.erase(std::remove_if(s.begin(), s.end(),
+                                   [&](const Task& t){ return std::binary_search(ids.begin(), ids.end(), t.id); }),
+                    s.end());
+        }
+        parts[1] = std::move(l);
+        l = join_lists(parts);
+    }
+    replay_journal(l);
+    if (keep != ListFilter::All) {
+        auto& v = l.tasks;
+        v.erase(std::remove_if(v.begin(), v.end(), [&](const Task& t){ return !keep_task(keep, t.done); }), v.end());
+    }
+    TT_COUNT(tasks, l.tasks.size());
+    return l;
+}
+
+// the done shard gets the completed tasks before the snapshot loses them,
+// so an interrupted save leaves a task in both files rather than in
+// neither. when nothing was dropped from it, a tsv shard is only appended
+// to; otherwise it is rewritten.
+static bool write_shard(const std::vector<Task>& done, bool binary) {
+    const fs::path p = shard_path(binary);
+    if (done.empty()) return binary ? save_binary(p, done) : save_tsv(p, done);
+    std::vector<int> have;
+    bool clean = true; // no torn final line that an append would extend
+    bool present = with_file_view(p, [&](std::string_view buf) {
+        for_each_snapshot_id(buf, binary, [&](int id) { have.push_back(id); });
+        clean = buf.empty() || buf.back() == '\n';
+    });
+    std::sort(have.begin(), have.end());
+    size_t kept = 0;
+    std::ostringstream add;
+    for (const auto& t : done) {
+        if (std::binary_search(have.begin(), have.end(), t.id)) ++kept;
+        else if (!binary) write_task(add, t);
+    }
+    if (present && kept == have.size()) {
+        if (kept == done.size()) return true;
+        if (!binary && clean) return append_file(p, add.str());
+    }
+    return binary ? save_binary(p, done) : save_tsv(p, done);
+}
+
+bool write_snapshot(const std::vector<Task>& v, bool binary, bool shard) {
+    const fs::path p = binary ? bin_path() : data_path();
+    auto save = [&](const std::vector<Task>& w) { return binary ? save_binary(p, w) : save_tsv(p, w); };
+    if (!shard) {
+        if (!save(v)) return false;
+        // once the snapshot holds everything, a leftover shard only duplicates
+        std::error_code ec;
+        fs::remove(shard_path(binary), ec);
+        return true;
+    }
+    std::vector<Task> pending, done;
+    for (const auto& t : v) (t.done ? done : pending).push_back(t);
+    return write_shard(done, binary) && save(pending);
+}
+
+bool save_tasks(const std::vector<Task>& v) {
+    return save_tasks(v, sharded());
+}
+
+bool save_tasks(const std::vector<Task>& v, bool shard) {
+    TT_PHASE(Phase::Save);
+    IndexHeader h;
+    bool stale = false;
+    int32_t max_id = read_index_header(h, stale) ? h.max_id : 0;
+    const std::vector<Task>* keep = &v;
+    std::vector<Task> rest;
+    if (g_archive_after >= 0) {
+        const uint32_t day = today(), age = static_cast<uint32_t>(g_archive_after);
+        size_t moved = 0;
+        if (!archive_tasks(v, day > age ? day - age : 1, rest, moved)) return false;
+        if (moved) keep = &rest;
+    }
+    if (!write_snapshot(*keep, use_binary(), shard)) return false;
+    std::error_code ec;
+    fs::remove(journal_path(), ec);
+    build_index(max_id);
+    return true;
+}
+
+bool shard_has(int id) {
+    if (!sharded()) return false;
+    bool found = false;
+    with_file_view(shard_path(use_binary()), [&](std::string_view buf) {
+        for_each_snapshot_id(buf, use_binary(), [&](int x) { found = found || x == id; });
+    });
+    return found && journal_has(id, true);
+}
+
+void scan_shard(TaskList& l, const std::function<bool(const Task&)>& match) {
+    if (!sharded()) return;
+    std::vector<int> touched;
+    for_each_record([&](std::string_view line) {
+        int id = 0;
+        if (line.size() >= 3 && line[1] == SEP && (line[0] == '+' || line[0] == '-') &&
+            parse_journal_id(line.substr(2), id))
+            touched.push_back(id);
+    });
+    std::sort(touched.begin(), touched.end());
+    const bool binary = use_binary();
+    with_file_view(shard_path(binary), [&](std::string_view buf) {
+        for_each_snapshot_task(buf, binary, [&](const Task& t, uint64_t) {
+            if (!match(t) || std::binary_search(touched.begin(), touched.end(), t.id)) return;
+            Task c = t;
+            c.title = l.titles.intern(t.title);
+            l.tasks.push_back(c);
+        });
+    });
+}
+
+} // namespace tt
@@ -0,0 +1,302 @@
+// the in-memory Store behind batch, serve and the TaskStore API
+#include "tt_internal.h"
+
+namespace tt {
+
+DiskSig disk_sig() {
+    DiskSig d;
+    d.binary = use_binary();
+    snapshot_sig(d.snap_size, d.snap_mtime);
+    std::error_code ec;
+    fs::path jp = journal_path();
+    if (fs::exists(jp, ec)) {
+        d.log_size = static_cast<uint64_t>(fs::file_size(jp, ec));
+        d.log_mtime = static_cast<int64_t>(fs::last_write_time(jp, ec).time_since_epoch().count());
+    }
+    return d;
+}
+
+Store Store::open() {
+    Store st;
+    IndexHeader h;
+    if (open_index(h)) st.max_id = h.max_id;
+    TaskList l = load_tasks();
+    st.tasks = std::move(l.tasks);
+    st.titles = std::move(l.titles);
+    st.reindex();
+    st.sig = disk_sig();
+    st.ids = id_space();
+    return st;
+}
+
+void Store::refresh() {
+    if (dirty() || disk_sig() == sig) return;
+    FileLock lk;
+    lock_for_read(lk);
+    bool keep = held_lock;
+    *this = open();
+    held_lock = keep;
+}
+
+void Store::reindex() {
+    removed.assign(tasks.size(), 0);
+    pos.clear();
+    pos.reserve(tasks.size());
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        pos[tasks[i].id] = i;
+        max_id = std::max(max_id, tasks[i].id);
+    }
+}
+
+const std::vector<Task>& Store::live() {
+    if (std::find(removed.begin(), removed.end(), 1) != removed.end()) {
+        size_t w = 0;
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            if (removed[i]) continue;
+            if (w != i) tasks[w] = tasks[i];
+            ++w;
+        }
+        tasks.resize(w);
+        reindex();
+    }
+    return tasks;
+}
+
+int Store::add(Task t) {
+    t.id = next_id(max_id, ids);
+    insert(t);
+    return t.id;
+}
+
+void Store::insert(Task t) {
+    max_id = std::max(max_id, t.id);
+    t.title = titles.intern(t.title);
+    pending += journal_add_record(t);
+    pending += '\n';
+    pos[t.id] = tasks.size();
+    tasks.push_back(t);
+    removed.push_back(0);
+}
+
+bool Store::mark_done(int id) {
+    Task* t = find(id);
+    if (!t) return false;
+    t->done = true;
+    pending += journal_id_record('x', id);
+    pending += '\n';
+    return true;
+}
+
+bool Store::remove(int id) {
+    if (!find(id)) return false;
+    removed[pos[id]] = 1;
+    pending += journal_id_record('-', id);
+    pending += '\n';
+    return true;
+}
+
+void Store::clear(bool all) {
+    live();
+    if (all) tasks.clear();
+    else tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [](const Task& t){ return t.done; }), tasks.end());
+    reindex();
+    pending += std::string("C") + SEP + (all ? "all" : "done") + '\n';
+    rewrite = true;
+}
+
+void Store::merge(std::ostream* err) {
+    Store fresh = open();
+    fresh.held_lock = held_lock;
+    std::unordered_map<int, int> remap;
+    auto map_id = [&](int id) { auto it = remap.find(id); return it == remap.end() ? id : it->second; };
+    std::string_view ops = pending;
+    while (!ops.empty()) {
+        size_t nl = ops.find('\n');
+        std::string_view line = ops.substr(0, nl);
+        ops.remove_prefix(nl == std::string_view::npos ? ops.size() : nl + 1);
+        if (line.size() < 3 || line[1] != SEP) continue;
+        std::string_view rest = line.substr(2);
+        int id = 0;
+        if (line[0] == '+') {
+            Task t;
+            if (!parse_task(rest, t)) continue;
+            int old = t.id;
+            if (old > fresh.max_id) fresh.max_id = old - 1;
+            int nid = fresh.add(t);
+            if (nid != old) {
+                remap[old] = nid;
+                if (err) *err << "tt: task #" << old << " renumbered #" << nid << " after a concurrent add\n";
+            }
+        } else if (line[0] == 'C') {
+            fresh.clear(rest == "all");
+        } else if (parse_journal_id(rest, id)) {
+            if (line[0] == 'x') fresh.mark_done(map_id(id));
+            else if (line[0] == '-') fresh.remove(map_id(id));
+        }
+    }
+    fresh.rewrite = fresh.rewrite || rewrite;
+    *this = std::move(fresh);
+}
+
+bool Store::flush(std::ostream* err) {
+    if (!dirty()) return true;
+    FileLock lk;
+    if (!held_lock) {
+        if (!lk.acquire(FileLock::Exclusive, true)) return false;
+        if (disk_sig() != sig) merge(err);
+    }
+    if (rewrite) {
+        if (!save_tasks(live())) return false;
+        if (max_id > 0 && !index_set_max(max_id)) return false;
+    } else if (!pending.empty()) {
+        IndexHeader h;
+        const bool indexed = open_index(h);
+        if (indexed && !index_set_max(std::max(h.max_id, max_id))) return false;
+        if (!append_records(pending)) return false;
+        if (indexed) {
+            // the index describes the snapshot, so ids it has that the
+            // journal just removed or added again are marked, in journal
+            // order, the way build_index would
+            split_lines(pending, [&](std::string_view line) {
+                int id = 0;
+                if (line.size() < 3 || line[1] != SEP || (line[0] != '+' && line[0] != '-')) return;
+                if (!parse_journal_id(line.substr(2), id)) return;
+                auto hit = index_find(id);
+                if (!hit) return;
+                if (line[0] == '-') index_tombstone(hit->pos);
+                else if (hit->off != IDX_NOPATCH) index_unpatchable(hit->pos);
+            });
+        }
+    }
+    pending.clear();
+    rewrite = false;
+    sig = disk_sig();
+    return true;
+}
+
+// TaskStore: a Store bound to one directory and list. each call points the
+// store paths at them, so separate TaskStores don't share any state.
+struct TaskStore::Impl {
+    fs::path dir;
+    std::string name;
+    Store st;
+};
+
+TaskStore::TaskStore(std::unique_ptr<Impl> impl) : impl_(std::move(impl)) {}
+
+TaskStore::~TaskStore() { flush(); }
+
+std::unique_ptr<TaskStore> TaskStore::open(const fs::path& dir, std::string* error) {
+    return open(dir, "tasks", error);
+}
+
+std::unique_ptr<TaskStore> TaskStore::open(const fs::path& dir, std::string_view list, std::string* error) {
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec)) {
+        if (error) *error = "not a directory: " + dir.string();
+        return nullptr;
+    }
+    if (!valid_list_name(list)) {
+        if (error) *error = "invalid list name: " + std::string(list);
+        return nullptr;
+    }
+    auto impl = std::make_unique<Impl>();
+    impl->dir = fs::absolute(dir, ec);
+    impl->name = std::string(list);
+    StoreDirScope scope(impl->dir, impl->name);
+    FileLock lk;
+    if (!lk.acquire(FileLock::Shared, true)) {
+        if (error) *error = "cannot lock the task store in " + dir.string();
+        return nullptr;
+    }
+    impl->st = Store::open();
+    return std::unique_ptr<TaskStore>(new TaskStore(std::move(impl)));
+}
+
+int TaskStore::add(std::string_view title, char priority, uint32_t due) {
+    std::string clean = trim(encode_field(title));
+    if (clean.empty() || (priority != 'H' && priority != 'M' && priority != 'L')) return -1;
+    Task t;
+    t.priority = priority;
+    t.due = due;
+    t.title = clean;
+    return impl_->st.add(t);
+}
+
+bool TaskStore::mark_done(int id) { return impl_->st.mark_done(id); }
+
+bool TaskStore::remove(int id) { return impl_->st.remove(id); }
+
+std::vector<Task> TaskStore::query(const Query& q) {
+    std::vector<Task> out;
+    for_each(q, [&](const Task& t) { out.push_back(t); });
+    return out;
+}
+
+void TaskStore::for_each(const Query& q, const std::function<void(const Task&)>& fn) {
+    const std::vector<Task>& v = impl_->st.live();
+    TaskFilter f(q.filter);
+    f.due_from = q.due_from;
+    f.due_to = q.due_to;
+    for (const SortEntry& e : sort_tasks(v, q.sort, f, q.offset, q.limit)) fn(v[e.idx]);
+}
+
+size_t TaskStore::size() { return impl_->st.live().size(); }
+
+bool TaskStore::flush() {
+    StoreDirScope scope(impl_->dir, impl_->name);
+    return impl_->st.flush();
+}
+
+void TaskStore::refresh() {
+    StoreDirScope scope(impl_->dir, impl_->name);
+    impl_->st.refresh();
+}
+
+// StorePool: the loaded stores in an LruCache, plus the ones evicted while
+// a caller still held them, so one store never gets two Stores in memory
+struct StorePool::Impl {
+    struct Entry {
+        std::string key;
+        std::shared_ptr<TaskStore> store;
+    };
+
+    explicit Impl(size_t capacity) : open(capacity) {}
+    LruCache<Entry> open;
+    std::unordered_map<std::string, std::weak_ptr<TaskStore>> held;
+};
+
+StorePool::StorePool(size_t capacity) : impl_(std::make_unique<Impl>(capacity)) {}
+
+StorePool::~StorePool() = default;
+
+std::shared_ptr<TaskStore> StorePool::get(const fs::path& dir, std::string_view list, std::string* error) {
+    std::error_code ec;
+    const std::string key = (fs::absolute(dir, ec) / (std::string(list) + ".tsv")).string();
+    if (Impl::Entry* hit = impl_->open.get(key)) return hit->store;
+    std::shared_ptr<TaskStore> s;
+    auto it = impl_->held.find(key);
+    if (it != impl_->held.end()) {
+        s = it->second.lock();
+        impl_->held.erase(it);
+    }
+    if (!s) s = TaskStore::open(dir, list, error);
+    if (!s) return nullptr;
+    for (auto h = impl_->held.begin(); h != impl_->held.end();)
+        h = h->second.expired() ? impl_->held.erase(h) : std::next(h);
+    return impl_->open.put(key, Impl::Entry{key, s}, [&](Impl::Entry& old) {
+        if (!old.store->flush()) return false;
+        if (old.store.use_count() > 1) impl_->held[old.key] = old.store;
+        return true;
+    }).store;
+}
+
+size_t StorePool::size() const { return impl_->open.size(); }
+
+bool StorePool::flush() {
+    bool ok = true;
+    impl_->open.for_each([&](Impl::Entry& e) { ok = e.store->flush() && ok; });
+    return ok;
+}
+
+} // namespace tt
@@ -0,0 +1,219 @@
+// streaming list: rows in the store's own order go out while it is read,
+// and other orders over stores larger than --mem-limit are sorted in
+// bounded runs on disk, then merged
+#include "tt_internal.h"
+
+#include <limits>
+#include <queue>
+
+namespace tt {
+
+// steps through the tasks of a snapshot image in file order
+struct SnapshotCursor {
+    std::string_view buf;
+    bool binary;
+    size_t at, end;
+
+    SnapshotCursor(std::string_view b, bool bin) : buf(b), binary(bin) {
+        at = binary ? BIN_HEADER : 0;
+        if (!binary) end = buf.size();
+        else end = bin_valid(buf) ? BIN_HEADER + static_cast<size_t>(get_u32(buf.data() + 8)) * BIN_RECORD : at;
+    }
+
+    bool next(Task& t) {
+        while (at < end) {
+            size_t here = at;
+            if (binary) {
+                at += BIN_RECORD;
+            } else {
+                size_t nl = buf.find('\n', at);
+                at = nl == std::string_view::npos ? buf.size() : nl + 1;
+            }
+            if (snapshot_task_at(buf, binary, here, t)) return true;
+        }
+        return false;
+    }
+};
+
+static bool id_ordered(std::string_view buf, bool binary) {
+    bool ok = true;
+    int last = std::numeric_limits<int>::min();
+    for_each_snapshot_id(buf, binary, [&](int id) {
+        ok = ok && id > last;
+        last = id;
+    });
+    return ok;
+}
+
+// --sort=id puts pending tasks before done ones, so each state is a pass
+// merging, by id, the snapshot, the done shard (done pass only) and the
+// journal's adds. an add supersedes the snapshot task with its id, which
+// keeps the merge to one row per id.
+static void stream_rows(std::string_view hot, std::string_view shard, bool binary, const TaskFilter& f,
+                        size_t offset, size_t limit, OutFormat fmt, std::ostream& os) {
+    JournalOverlay j = read_overlay();
+    std::vector<const Task*> adds;
+    for (size_t i = 0; i < j.adds.size(); ++i)
+        if (j.add_live[i]) adds.push_back(&j.adds[i]);
+    std::stable_sort(adds.begin(), adds.end(), [](const Task* a, const Task* b) { return a->id < b->id; });
+    auto next_row = [&](SnapshotCursor& c, Task& t) {
+        while (c.next(t)) {
+            if (j.dead.count(t.id) || j.add_pos.count(t.id)) continue;
+            if (j.done.count(t.id)) t.done = true;
+            return true;
+        }
+        return false;
+    };
+    const FilterProgram p = f.compile();
+    TT_PHASE(Phase::Output);
+    TaskWriter w(fmt, os);
+    size_t skip = offset, left = limit ? limit : std::numeric_limits<size_t>::max();
+    for (bool done : {false, true}) {
+        if (!keep_task(f.state, done)) continue;
+        SnapshotCursor a(hot, binary), b(done ? shard : std::string_view(), binary);
+        Task ta, tb;
+        bool ha = next_row(a, ta), hb = next_row(b, tb);
+        size_t k = 0;
+        while (left) {
+            // ties go to the snapshot: a task in both files is its copy
+            const Task* t = ha ? &ta : nullptr;
+            if (hb && (!t || tb.id < t->id)) t = &tb;
+            if (k < adds.size() && (!t || adds[k]->id < t->id)) t = adds[k];
+            if (!t) break;
+            const Task row = *t;
+            if (ha && ta.id == row.id) ha = next_row(a, ta);
+            if (hb && tb.id == row.id) hb = next_row(b, tb);
+            if (k < adds.size() && adds[k]->id == row.id) ++k;
+            if (row.done != done || !p.matches(row)) continue;
+            if (skip) { --skip; continue; }
+            w.write(row);
+            --left;
+        }
+    }
+}
+
+bool stream_list(const TaskFilter& f, size_t offset, size_t limit, OutFormat fmt, std::ostream& os) {
+    const bool binary = use_binary();
+    const bool with_shard = f.state != ListFilter::Pending && sharded();
+    bool ordered = true;
+    auto run = [&](std::string_view hot, std::string_view shard) {
+        ordered = id_ordered(hot, binary) && id_ordered(shard, binary);
+        if (ordered) stream_rows(hot, shard, binary, f, offset, limit, fmt, os);
+    };
+    bool read = with_file_view(store_path(), [&](std::string_view hot) {
+        if (!with_shard || !with_file_view(shard_path(binary), [&](std::string_view s) { run(hot, s); }))
+            run(hot, std::string_view());
+    });
+    // no snapshot yet: everything is in the journal
+    if (!read) run(std::string_view(), std::string_view());
+    return ordered;
+}
+
+size_t list_bytes(ListFilter keep) {
+    std::error_code ec;
+    size_t n = 0;
+    for (const fs::path& p : {store_path(), journal_path()})
+        if (fs::exists(p, ec)) n += static_cast<size_t>(fs::file_size(p, ec));
+    if (keep != ListFilter::Pending && sharded()) n += static_cast<size_t>(fs::file_size(shard_path(use_binary()), ec));
+    return n;
+}
+
+// external sort: live tasks are gathered in load order until the chunk
+// reaches the budget, then sorted and written out as a run of (u64 sort
+// key, task line) records. the runs are merged on (key, run number), which
+// is the (key, load position) order of the in-memory sort, so both print
+// the same rows.
+static fs::path run_path(size_t n) {
+    std::string name = ".tt-sort-";
+#if defined(TT_HAVE_POSIX_IO)
+    name += std::to_string(::getpid());
+#elif defined(_WIN32)
+    name += std::to_string(::_getpid());
+#endif
+    return store_dir() / (name + '-' + std::to_string(n));
+}
+
+struct SortRun {
+    std::ifstream in;
+    uint64_t key{0};
+    std::string line;
+
+    bool advance() {
+        char k[8];
+        if (!in.read(k, 8) || !std::getline(in, line)) return false;
+        std::memcpy(&key, k, 8);
+        return true;
+    }
+};
+
+bool external_list(const TaskFilter& f, SortKey k, size_t offset, size_t limit, size_t mem_limit, OutFormat fmt,
+                   std::ostream& os) {
+    const FilterProgram p = f.compile();
+    std::vector<fs::path> runs;
+    TaskList chunk;
+    size_t bytes = 0;
+    bool ok = true;
+    auto spill = [&] {
+        const fs::path path = run_path(runs.size());
+        runs.push_back(path);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        for (const SortEntry& e : sort_tasks(chunk.tasks, k)) {
+            out.write(reinterpret_cast<const char*>(&e.key), 8);
+            write_task(out, chunk.tasks[e.idx]);
+        }
+        out.close();
+        ok = ok && !out.fail();
+        chunk = TaskList();
+        bytes = 0;
+    };
+    {
+        TT_PHASE(Phase::Load);
+        for_each_live_task(f.state, [&](const Task& t) {
+            if (!ok || !p.matches(t)) return;
+            Task c = t;
+            c.title = chunk.titles.intern(t.title);
+            chunk.tasks.push_back(c);
+            bytes += sizeof(Task) + sizeof(SortEntry) + t.title.size();
+            if (bytes >= mem_limit) spill();
+        });
+    }
+    auto remove_runs = [&] {
+        std::error_code ec;
+        for (const auto& r : runs) fs::remove(r, ec);
+    };
+    if (runs.empty()) {
+        // it fit after all
+        list_cmd(chunk.tasks, TaskFilter(), k, offset, limit, fmt, os);
+        return true;
+    }
+    if (!chunk.tasks.empty()) spill();
+    if (!ok) { remove_runs(); return false; }
+
+    std::vector<SortRun> rs(runs.size());
+    using Head = std::pair<uint64_t, size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    for (size_t i = 0; i < rs.size(); ++i) {
+        rs[i].in.open(runs[i], std::ios::binary);
+        if (rs[i].advance()) heads.emplace(rs[i].key, i);
+    }
+    {
+        TT_PHASE(Phase::Output);
+        TaskWriter w(fmt, os);
+        size_t skip = offset, left = limit ? limit : std::numeric_limits<size_t>::max();
+        while (!heads.empty() && left) {
+            const size_t i = heads.top().second;
+            heads.pop();
+            Task t;
+            if (parse_task(rs[i].line, t)) {
+                if (skip) --skip;
+                else { w.write(t); --left; }
+            }
+            if (rs[i].advance()) heads.emplace(rs[i].key, i);
+        }
+    }
+    rs.clear();
+    remove_runs();
+    return true;
+}
+
+} // namespace tt
@@ -0,0 +1,690 @@
+// tt sync: replicates a list between copies of it on other hosts by shipping
+// the changes each copy makes instead of its files
+#include "tt_internal.h"
+
+namespace tt {
+
+// every copy taking part is a numbered node (tt sync init N) and keeps, in
+// <store>.sync/:
+//   node        "N M": its node number and the number of nodes, the same
+//               on every node; ids are allocated per node (see IdSpace)
+//   feed        every change the node knows of, its own and those applied
+//               from peers, in the order it learned them, one
+//               "<origin node>|<seq>|<journal record>" line each. seq counts
+//               the origin's own changes from 1
+//   state       its own last seq, the highest seq applied from each other
+//               origin, how far the store files have been read into the
+//               feed, and the owners of ids that don't follow IdSpace
+//   mirror.tsv  the tasks as the feed had them at one point of it
+// a node asks a peer for the feed entries past the seqs it has from each
+// origin and applies them in order, so only changes cross the wire, each
+// once, and a change reaches every node linked to its origin by syncs.
+//
+// the node's own changes join the feed when it next syncs: journal records
+// appended since the last sync are taken as they are; anything that
+// replaced or patched the snapshot (compact, clear, done on a snapshot task,
+// shard, archive, import) is found by diffing the store against the mirror.
+//
+// a task is known everywhere by one id, and belongs to the node that added
+// it: the id's remainder mod nodes, unless state records another owner
+// (tasks from before init). "x" and "-" records name the owner after a
+// second '|' when it isn't the record's origin, and only touch a task of
+// that owner. two different tasks under one id, possible only for ids from
+// before init, are settled the same way on every node: the lower node's
+// task keeps the id, and the other's own node moves it to a new id, which
+// reaches the others as an ordinary remove and add. copies of one task that
+// were in both stores before init are merged instead.
+static const char* const SYNC_MAGIC = "tt-sync";
+
+static fs::path sync_dir() {
+    return store_dir() / (store_name() + ".sync");
+}
+
+IdSpace id_space() {
+    IdSpace s;
+    std::ifstream in(sync_dir() / "node");
+    int32_t node = 0, nodes = 0;
+    if (in >> node >> nodes && nodes > 0 && node >= 0 && node < nodes) {
+        s.node = node;
+        s.nodes = nodes;
+    }
+    return s;
+}
+
+// highest seq held from each origin
+using SeqVector = std::unordered_map<int32_t, uint64_t>;
+
+struct SyncState {
+    IdSpace ids;
+    uint64_t seq{0};                          // own changes in the feed
+    SeqVector applied;                        // per other origin
+    DiskSig read;                             // the store files as far as the feed has them
+    uint64_t mirror_at{0};                    // feed bytes the mirror reflects
+    std::unordered_map<int, int32_t> owner;   // ids whose owner isn't id mod nodes
+    std::unordered_set<uint64_t> alias;       // other (owner, id) names of merged copies
+};
+
+static uint64_t alias_key(int32_t owner, int id) {
+    return uint64_t(uint32_t(owner)) << 32 | uint32_t(id);
+}
+
+static int32_t owner_of(const SyncState& s, int id) {
+    auto it = s.owner.find(id);
+    return it != s.owner.end() ? it->second : id % s.ids.nodes;
+}
+
+static void set_owner(SyncState& s, int id, int32_t owner) {
+    if (id % s.ids.nodes == owner) s.owner.erase(id);
+    else s.owner[id] = owner;
+}
+
+// whether the task here under id is the one owner knows by it
+static bool names(const SyncState& s, int32_t owner, int id) {
+    return owner_of(s, id) == owner || s.alias.count(alias_key(owner, id));
+}
+
+// drops owners and aliases of ids no longer live
+static void prune(SyncState& s, const std::vector<Task>& live) {
+    std::unordered_set<int> ids;
+    ids.reserve(live.size());
+    for (const Task& t : live) ids.insert(t.id);
+    for (auto it = s.owner.begin(); it != s.owner.end();)
+        it = ids.count(it->first) ? std::next(it) : s.owner.erase(it);
+    for (auto it = s.alias.begin(); it != s.alias.end();)
+        it = ids.count(static_cast<int>(uint32_t(*it))) ? std::next(it) : s.alias.erase(it);
+}
+
+static fs::path feed_path() { return sync_dir() / "feed"; }
+static fs::path state_path() { return sync_dir() / "state"; }
+static fs::path mirror_path() { return sync_dir() / "mirror.tsv"; }
+
+static bool synced() {
+    std::error_code ec;
+    return fs::exists(sync_dir() / "node", ec);
+}
+
+static bool read_state(SyncState& s) {
+    s.ids = id_space();
+    std::ifstream in(state_path());
+    if (!in) return false;
+    std::string key;
+    while (in >> key) {
+        if (key == "seq") in >> s.seq;
+        else if (key == "files") in >> s.read.binary >> s.read.snap_size >> s.read.snap_mtime >> s.read.log_size;
+        else if (key == "mirror") in >> s.mirror_at;
+        else if (key == "applied") { int32_t o; uint64_t q; in >> o >> q; s.applied[o] = q; }
+        else if (key == "owner") { int id; int32_t o; in >> id >> o; s.owner[id] = o; }
+        else if (key == "alias") { int32_t o; int id; in >> o >> id; s.alias.insert(alias_key(o, id)); }
+        else return false;
+    }
+    return in.eof();
+}
+
+static bool write_state(const SyncState& s) {
+    std::ostringstream out;
+    out << "seq " << s.seq << "\n"
+        << "files " << s.read.binary << ' ' << s.read.snap_size << ' ' << s.read.snap_mtime << ' '
+        << s.read.log_size << "\n"
+        << "mirror " << s.mirror_at << "\n";
+    for (const auto& e : s.applied) out << "applied " << e.first << ' ' << e.second << "\n";
+    for (const auto& e : s.owner) out << "owner " << e.first << ' ' << e.second << "\n";
+    for (uint64_t k : s.alias) out << "alias " << int32_t(k >> 32) << ' ' << int(uint32_t(k)) << "\n";
+    return replace_file(state_path(), out.str());
+}
+
+// "N:SEQ,N:SEQ...", as tt sync since prints it
+static std::string format_vector(const SeqVector& v) {
+    std::vector<std::pair<int32_t, uint64_t>> sorted(v.begin(), v.end());
+    std::sort(sorted.begin(), sorted.end());
+    std::string out;
+    for (const auto& e : sorted) {
+        if (!out.empty()) out += ',';
+        out += std::to_string(e.first) + ':' + std::to_string(e.second);
+    }
+    return out;
+}
+
+static bool parse_vector(std::string_view s, SeqVector& v) {
+    while (!s.empty()) {
+        size_t comma = s.find(',');
+        std::string_view item = s.substr(0, comma);
+        s.remove_prefix(comma == std::string_view::npos ? s.size() : comma + 1);
+        const char* e = item.data() + item.size();
+        int32_t node = 0;
+        uint64_t seq = 0;
+        auto r = std::from_chars(item.data(), e, node);
+        if (r.ec != std::errc() || r.ptr == e || *r.ptr != ':') return false;
+        r = std::from_chars(r.ptr + 1, e, seq);
+        if (r.ec != std::errc() || r.ptr != e) return false;
+        v[node] = seq;
+    }
+    return true;
+}
+
+// what this node holds: its own seq and what it applied from the others
+static SeqVector held(const SyncState& s) {
+    SeqVector v = s.applied;
+    v[s.ids.node] = s.seq;
+    return v;
+}
+
+struct FeedEntry {
+    int32_t origin{0};
+    uint64_t seq{0};
+    std::string_view rec;
+};
+
+static bool parse_entry(std::string_view line, FeedEntry& e) {
+    const char* end = line.data() + line.size();
+    auto r = std::from_chars(line.data(), end, e.origin);
+    if (r.ec != std::errc() || r.ptr == end || *r.ptr != SEP) return false;
+    r = std::from_chars(r.ptr + 1, end, e.seq);
+    if (r.ec != std::errc() || r.ptr == end || *r.ptr != SEP) return false;
+    e.rec = std::string_view(r.ptr + 1, static_cast<size_t>(end - r.ptr - 1));
+    return e.rec.size() >= 3 && e.rec[1] == SEP && (e.rec[0] == '+' || e.rec[0] == 'x' || e.rec[0] == '-');
+}
+
+// the id an "x" or "-" record names, and its owner: the one given after the
+// id, or else the record's origin
+static bool parse_target(std::string_view rest, int32_t origin, int& id, int32_t& owner) {
+    const char* end = rest.data() + rest.size();
+    auto r = std::from_chars(rest.data(), end, id);
+    if (r.ec != std::errc()) return false;
+    owner = origin;
+    if (r.ptr == end) return true;
+    return *r.ptr == SEP && std::from_chars(r.ptr + 1, end, owner).ec == std::errc();
+}
+
+// calls fn(const FeedEntry&) for each complete feed line at or past from
+template <class Fn>
+static void for_each_entry(std::string_view buf, uint64_t from, Fn&& fn) {
+    if (from >= buf.size()) return;
+    buf.remove_prefix(static_cast<size_t>(from));
+    size_t end = buf.rfind('\n');
+    if (end == std::string_view::npos) return;
+    split_lines(buf.substr(0, end + 1), [&](std::string_view line) {
+        FeedEntry e;
+        if (parse_entry(line, e)) fn(e);
+    });
+}
+
+static uint64_t feed_size() {
+    std::error_code ec;
+    uintmax_t n = fs::file_size(feed_path(), ec);
+    return ec ? 0 : static_cast<uint64_t>(n);
+}
+
+static bool same_task(const Task& a, const Task& b) {
+    return a.priority == b.priority && a.due == b.due && a.title == b.title;
+}
+
+// the feed's tasks: the mirror with the entries past mirror_at replayed over
+// it. apply moves the mirror past what it adds, so those are all this
+// node's own, in its own ids
+static std::unordered_map<int, Task> feed_tasks(const SyncState& s, TitleArena& titles) {
+    TaskList m = load_tsv(mirror_path());
+    std::unordered_map<int, Task> tasks;
+    tasks.reserve(m.tasks.size());
+    for (const Task& t : m.tasks) tasks[t.id] = t;
+    titles.adopt(std::move(m.titles));
+    with_file_view(feed_path(), [&](std::string_view buf) {
+        for_each_entry(buf, s.mirror_at, [&](const FeedEntry& e) {
+            if (e.origin != s.ids.node) return;
+            std::string_view rest = e.rec.substr(2);
+            int id = 0;
+            int32_t owner = 0;
+            if (e.rec[0] == '+') {
+                Task t;
+                if (parse_task(rest, t, &titles)) tasks[t.id] = t;
+            } else if (parse_target(rest, e.origin, id, owner)) {
+                auto it = tasks.find(id);
+                if (it == tasks.end()) return;
+                if (e.rec[0] == 'x') it->second.done = true;
+                else tasks.erase(it);
+            }
+        });
+    });
+    return tasks;
+}
+
+// an "x" or "-" record for the task here under id, naming its owner
+static std::string target_record(const SyncState& s, char op, int id) {
+    std::string rec = journal_id_record(op, id);
+    const int32_t owner = owner_of(s, id);
+    if (owner != s.ids.node) rec += SEP + std::to_string(owner);
+    return rec;
+}
+
+// appends this node's changes since the feed last read the store files.
+// the caller holds the exclusive lock.
+static bool capture(SyncState& s) {
+    const DiskSig now = disk_sig();
+    std::string lines;
+    auto own = [&](const std::string& rec) {
+        lines += std::to_string(s.ids.node) + SEP + std::to_string(++s.seq) + SEP + rec + '\n';
+    };
+    DiskSig read = now;
+    bool reseed = false;
+    TaskList cur;
+    if (now.same_snapshot(s.read) && now.log_size >= s.read.log_size) {
+        if (now.log_size == s.read.log_size) return true;
+        std::ifstream in(journal_path(), std::ios::binary);
+        in.seekg(static_cast<std::streamoff>(s.read.log_size));
+        std::string buf(static_cast<size_t>(now.log_size - s.read.log_size), '\0');
+        if (!in.read(&buf[0], static_cast<std::streamsize>(buf.size()))) return false;
+        // a record still being written waits for the next sync
+        const size_t end = buf.rfind('\n');
+        if (end == std::string::npos) return true;
+        read.log_size = s.read.log_size + end + 1;
+        split_lines(std::string_view(buf).substr(0, end + 1), [&](std::string_view line) {
+            if (line.size() < 3 || line[1] != SEP) return;
+            Task t;
+            int id = 0;
+            if (line[0] == '+' && parse_task(line.substr(2), t)) {
+                set_owner(s, t.id, s.ids.node);
+                own(std::string(line));
+            } else if ((line[0] == 'x' || line[0] == '-') && parse_journal_id(line.substr(2), id)) {
+                own(target_record(s, line[0], id));
+            }
+        });
+    } else {
+        TitleArena titles;
+        std::unordered_map<int, Task> before = feed_tasks(s, titles);
+        cur = load_tasks();
+        std::vector<const Task*> order;
+        order.reserve(cur.tasks.size());
+        for (const Task& t : cur.tasks) order.push_back(&t);
+        std::sort(order.begin(), order.end(), [](const Task* a, const Task* b) { return a->id < b->id; });
+        std::unordered_set<int> live;
+        live.reserve(order.size());
+        for (const Task* t : order) {
+            live.insert(t->id);
+            auto it = before.find(t->id);
+            if (it == before.end() || !same_task(it->second, *t)) {
+                set_owner(s, t->id, s.ids.node);
+                own(journal_add_record(*t));
+            } else if (t->done && !it->second.done) {
+                own(target_record(s, 'x', t->id));
+            }
+        }
+        std::vector<int> gone;
+        for (const auto& e : before)
+            if (!live.count(e.first)) gone.push_back(e.first);
+        std::sort(gone.begin(), gone.end());
+        for (int id : gone) own(target_record(s, '-', id));
+        prune(s, cur.tasks);
+        reseed = true;
+    }
+    if (!lines.empty() && !append_file(feed_path(), lines)) return false;
+    // the mirror moves up to the store as it stands, so the next diff only
+    // replays what the feed gained after this
+    if (reseed) {
+        if (!save_tsv(mirror_path(), cur.tasks)) return false;
+        s.mirror_at = feed_size();
+    }
+    s.read = read;
+    return true;
+}
+
+// the first line of a change stream: who sends it
+static void put_header(const SyncState& s, std::string& out) {
+    out += std::string(SYNC_MAGIC) + ' ' + std::to_string(s.ids.node) + ' ' + std::to_string(s.ids.nodes) + '\n';
+}
+
+static bool parse_header(std::string_view line, IdSpace& from) {
+    std::istringstream in{std::string(line)};
+    std::string magic;
+    return in >> magic >> from.node >> from.nodes && magic == SYNC_MAGIC;
+}
+
+// the feed entries newer than since, behind the header
+static bool sync_changes(const SeqVector& since, std::string& out, std::ostream& err) {
+    FileLock lk;
+    if (!lk.acquire(FileLock::Exclusive, true)) { err << "Error: cannot lock the task store.\n"; return false; }
+    SyncState s;
+    if (!synced() || !read_state(s)) { err << "Not a sync node: " << data_path().string() << "\n"; return false; }
+    if (!capture(s) || !write_state(s)) { err << "Error: cannot write " << feed_path().string() << "\n"; return false; }
+    put_header(s, out);
+    with_file_view(feed_path(), [&](std::string_view buf) {
+        for_each_entry(buf, 0, [&](const FeedEntry& e) {
+            auto it = since.find(e.origin);
+            if (it != since.end() && e.seq <= it->second) return;
+            out += std::to_string(e.origin) + SEP + std::to_string(e.seq) + SEP;
+            out += e.rec;
+            out += '\n';
+        });
+    });
+    return true;
+}
+
+static bool sync_since(SeqVector& v, std::ostream& err) {
+    FileLock lk;
+    lock_for_read(lk);
+    SyncState s;
+    if (!synced() || !read_state(s)) { err << "Not a sync node: " << data_path().string() << "\n"; return false; }
+    v = held(s);
+    return true;
+}
+
+// applies a change stream. entries from each origin are taken in order and
+// once; applied entries join this node's feed, so they travel on, after any
+// changes of this node's own that they caused.
+static bool sync_apply(std::string_view in, std::ostream& out, std::ostream& err) {
+    size_t nl = in.find('\n');
+    IdSpace from;
+    if (nl == std::string_view::npos || !parse_header(in.substr(0, nl), from)) {
+        err << "Not a tt sync change stream.\n";
+        return false;
+    }
+    in.remove_prefix(nl + 1);
+    FileLock lk;
+    if (!lk.acquire(FileLock::Exclusive, true)) { err << "Error: cannot lock the task store.\n"; return false; }
+    SyncState s;
+    if (!synced() || !read_state(s)) { err << "Not a sync node: " << data_path().string() << "\n"; return false; }
+    if (from.nodes != s.ids.nodes) {
+        err << "Node " << from.node << " counts " << from.nodes << " nodes, this one " << s.ids.nodes << ".\n";
+        return false;
+    }
+    if (from.node == s.ids.node) {
+        err << "The peer is node " << from.node << " too; every copy needs its own node number.\n";
+        return false;
+    }
+    std::vector<FeedEntry> entries;
+    for_each_entry(in, 0, [&](const FeedEntry& e) { entries.push_back(e); });
+    for (const FeedEntry& e : entries) {
+        if (e.origin == s.ids.node && e.seq > s.seq) {
+            err << "Changes from another node " << e.origin << "; every copy needs its own node number.\n";
+            return false;
+        }
+    }
+    // this node's own changes go into the feed before the peer's
+    if (!capture(s)) { err << "Error: cannot write " << feed_path().string() << "\n"; return false; }
+
+    Store st = Store::open();
+    st.held_lock = true;
+    std::string lines;
+    auto own = [&](const std::string& rec) {
+        lines += std::to_string(s.ids.node) + SEP + std::to_string(++s.seq) + SEP + rec + '\n';
+    };
+    size_t applied = 0;
+    for (const FeedEntry& e : entries) {
+        if (e.origin == s.ids.node) continue;
+        uint64_t& have = s.applied[e.origin];
+        if (e.seq <= have) continue;
+        std::string_view rest = e.rec.substr(2);
+        int id = 0;
+        int32_t owner = 0;
+        if (e.rec[0] == '+') {
+            Task t;
+            if (!parse_task(rest, t)) continue;
+            Task* mine = st.find(t.id);
+            if (!mine) {
+                st.insert(t);
+                set_owner(s, t.id, e.origin);
+            } else if (names(s, e.origin, t.id) || same_task(*mine, t)) {
+                // one task that both stores had before they synced: either
+                // owner's name reaches it, and the lower owner's is used
+                const int32_t mine_owner = owner_of(s, t.id);
+                if (mine_owner != e.origin) {
+                    s.alias.insert(alias_key(e.origin, t.id));
+                    s.alias.insert(alias_key(mine_owner, t.id));
+                    if (e.origin < mine_owner) set_owner(s, t.id, e.origin);
+                }
+                if (t.done && !mine->done) st.mark_done(t.id);
+            } else if (e.origin < owner_of(s, t.id)) {
+                // the peer's task keeps the id. this node moves its own task
+                // to a new id; a third node's gives way here and is moved by
+                // that node once it hears of the clash
+                Task moved = *mine;
+                const bool ours = owner_of(s, t.id) == s.ids.node;
+                if (ours) own(target_record(s, '-', t.id));
+                st.remove(t.id);
+                st.insert(t);
+                set_owner(s, t.id, e.origin);
+                if (ours) {
+                    moved.id = st.add(moved);
+                    own(journal_add_record(moved));
+                    err << "tt: task #" << t.id << " is node " << e.origin << "'s there; yours moved to #"
+                        << moved.id << "\n";
+                }
+            }
+            // otherwise the task here keeps the id, and the peer's own node
+            // moves its task when it hears of this one
+        } else if (parse_target(rest, e.origin, id, owner)) {
+            if (st.find(id) && names(s, owner, id)) {
+                if (e.rec[0] == 'x') st.mark_done(id);
+                else st.remove(id);
+            }
+        }
+        lines += std::to_string(e.origin) + SEP + std::to_string(e.seq) + SEP;
+        lines += e.rec;
+        lines += '\n';
+        have = e.seq;
+        ++applied;
+    }
+    // an id removed here and added again by a peer is journaled like any
+    // other; flush marks it in the index so done and rm still find it
+    if (!st.flush(&err)) { err << "Error: cannot write tasks.\n"; return false; }
+    if (!lines.empty()) {
+        const std::vector<Task>& live = st.live();
+        prune(s, live);
+        // what apply wrote is already in the feed, so the mirror and the
+        // files read move past it
+        if (!append_file(feed_path(), lines) || !save_tsv(mirror_path(), live)) {
+            err << "Error: cannot write " << feed_path().string() << "\n";
+            return false;
+        }
+        s.mirror_at = feed_size();
+        s.read = disk_sig();
+    }
+    if (!write_state(s)) { err << "Error: cannot write " << state_path().string() << "\n"; return false; }
+    out << "Applied " << applied << (applied == 1 ? " change" : " changes") << " from node " << from.node << ".\n";
+    return true;
+}
+
+static int sync_init(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    int node = -1, nodes = 100;
+    for (size_t i = 2; i < args.size(); ++i) {
+        const std::string& a = args[i];
+        if (a.rfind("--nodes=", 0) == 0) {
+            nodes = parse_int(a.substr(8));
+            if (nodes < 1) { err << "Invalid --nodes value.\n"; return 1; }
+        }
+        else if (node < 0 && !a.empty() && a[0] != '-') {
+            node = parse_int(a);
+            if (node < 0) { err << "Invalid node number.\n"; return 1; }
+        }
+        else { err << "Unknown arg: " << a << "\n"; return 1; }
+    }
+    if (node < 0) { err << "Usage: tt sync init <node> [--nodes=N]\n"; return 1; }
+    if (node >= nodes) { err << "Node numbers run from 0 to " << nodes - 1 << ".\n"; return 1; }
+    FileLock lk;
+    if (!lk.acquire(FileLock::Exclusive, true)) { err << "Error: cannot lock the task store.\n"; return 1; }
+    if (synced()) {
+        IdSpace ids = id_space();
+        err << "Already node " << ids.node << " of " << ids.nodes << ".\n";
+        return 1;
+    }
+    std::error_code ec;
+    fs::create_directories(sync_dir(), ec);
+    // the tasks already here are this node's first changes, so a new peer
+    // pulling from it gets them all
+    SyncState s;
+    s.ids.node = node;
+    s.ids.nodes = nodes;
+    TaskList l = load_tasks();
+    std::sort(l.tasks.begin(), l.tasks.end(), [](const Task& a, const Task& b) { return a.id < b.id; });
+    std::string lines;
+    for (const Task& t : l.tasks) {
+        set_owner(s, t.id, node);
+        lines += std::to_string(node) + SEP + std::to_string(++s.seq) + SEP + journal_add_record(t) + '\n';
+    }
+    s.read = disk_sig();
+    bool ok = replace_file(feed_path(), lines) && save_tsv(mirror_path(), l.tasks);
+    s.mirror_at = lines.size();
+    ok = ok && write_state(s) && replace_file(sync_dir() / "node", std::to_string(node) + ' ' + std::to_string(nodes) + '\n');
+    if (!ok) {
+        fs::remove_all(sync_dir(), ec);
+        err << "Error: cannot write " << sync_dir().string() << "\n";
+        return 1;
+    }
+    out << "Node " << node << " of " << nodes << "; " << s.seq << (s.seq == 1 ? " task" : " tasks")
+        << " in the feed.\n";
+    return 0;
+}
+
+static int sync_status(std::ostream& out, std::ostream& err) {
+    FileLock lk;
+    lock_for_read(lk);
+    SyncState s;
+    if (!synced() || !read_state(s)) { err << "Not a sync node: " << data_path().string() << "\n"; return 1; }
+    out << "Node " << s.ids.node << " of " << s.ids.nodes << ", at change " << s.seq << "; feed "
+        << feed_size() << " bytes.\n";
+    std::vector<std::pair<int32_t, uint64_t>> peers(s.applied.begin(), s.applied.end());
+    std::sort(peers.begin(), peers.end());
+    for (const auto& p : peers) out << "  node " << p.first << ": through change " << p.second << "\n";
+    return 0;
+}
+
+// a peer: another store on a path this process can open, or a command
+// that runs tt against the peer's store (tt sync appends its own arguments)
+struct Peer {
+    fs::path dir;
+    std::string name;
+    std::string cmd;
+};
+
+static bool run_pipe(const std::string& cmd, const std::string* input, std::string* output) {
+#if defined(TT_HAVE_POSIX_IO)
+    std::signal(SIGPIPE, SIG_IGN);
+    FILE* f = ::popen(cmd.c_str(), input ? "w" : "r");
+#elif defined(_WIN32)
+    FILE* f = ::_popen(cmd.c_str(), input ? "wb" : "rb");
+#else
+    FILE* f = nullptr;
+#endif
+    if (!f) return false;
+    bool ok = true;
+    if (input) {
+        ok = std::fwrite(input->data(), 1, input->size(), f) == input->size();
+    } else {
+        char buf[1 << 16];
+        size_t n;
+        while ((n = std::fread(buf, 1, sizeof buf, f)) > 0) output->append(buf, n);
+        ok = !std::ferror(f);
+    }
+#if defined(TT_HAVE_POSIX_IO)
+    return ::pclose(f) == 0 && ok;
+#elif defined(_WIN32)
+    return ::_pclose(f) == 0 && ok;
+#else
+    return false;
+#endif
+}
+
+// pull: this node applies what the peer has and it lacks. push: the peer
+// applies what this node has and it lacks.
+static int sync_transfer(bool push, const Peer& p, std::ostream& out, std::ostream& err) {
+    SeqVector since;
+    std::string changes;
+    if (!p.cmd.empty()) {
+        if (push) {
+            std::string v;
+            if (!run_pipe(p.cmd + " sync since", nullptr, &v)) { err << "Peer command failed: " << p.cmd << "\n"; return 1; }
+            if (!parse_vector(trim(v), since)) { err << "Peer sent no sync position.\n"; return 1; }
+            if (!sync_changes(since, changes, err)) return 1;
+            if (!run_pipe(p.cmd + " sync apply -", &changes, nullptr)) { err << "Peer command failed: " << p.cmd << "\n"; return 1; }
+            return 0;
+        }
+        if (!sync_since(since, err)) return 1;
+        if (!run_pipe(p.cmd + " sync changes --since=" + format_vector(since), nullptr, &changes)) {
+            err << "Peer command failed: " << p.cmd << "\n";
+            return 1;
+        }
+        return sync_apply(changes, out, err) ? 0 : 1;
+    }
+    // a peer on a path: both ends run here, one store at a time
+    auto at_peer = [&](auto&& fn) {
+        StoreDirScope scope(p.dir, p.name);
+        return fn();
+    };
+    if (push) {
+        if (!at_peer([&] { return sync_since(since, err); }) || !sync_changes(since, changes, err)) return 1;
+        return at_peer([&] { return sync_apply(changes, out, err); }) ? 0 : 1;
+    }
+    if (!sync_since(since, err) || !at_peer([&] { return sync_changes(since, changes, err); })) return 1;
+    return sync_apply(changes, out, err) ? 0 : 1;
+}
+
+int sync_cmd(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    const std::string sub = args.size() > 1 ? args[1] : "";
+    if (sub == "init") return sync_init(args, out, err);
+    if (sub == "status" && args.size() == 2) return sync_status(out, err);
+    if (sub == "since" && args.size() == 2) {
+        SeqVector v;
+        if (!sync_since(v, err)) return 1;
+        out << format_vector(v) << "\n";
+        return 0;
+    }
+    if (sub == "changes") {
+        SeqVector since;
+        for (size_t i = 2; i < args.size(); ++i) {
+            const std::string& a = args[i];
+            if (a.rfind("--since=", 0) == 0) {
+                if (!parse_vector(a.substr(8), since)) { err << "Invalid --since value.\n"; return 1; }
+            }
+            else { err << "Unknown arg: " << a << "\n"; return 1; }
+        }
+        std::string changes;
+        if (!sync_changes(since, changes, err)) return 1;
+        out << changes;
+        return 0;
+    }
+    if (sub == "apply" && args.size() <= 3) {
+        std::string buf;
+        if (args.size() == 3 && args[2] != "-") {
+            std::ifstream in(args[2], std::ios::binary);
+            if (!in) { err << "Cannot open " << args[2] << "\n"; return 1; }
+            buf.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        } else {
+            buf.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+        }
+        return sync_apply(buf, out, err) ? 0 : 1;
+    }
+    if (sub == "pull" || sub == "push") {
+        Peer p;
+        std::string file;
+        for (size_t i = 2; i < args.size(); ++i) {
+            const std::string& a = args[i];
+            if (a.rfind("--cmd=", 0) == 0) p.cmd = a.substr(6);
+            else if (file.empty() && !a.empty() && a[0] != '-') file = a;
+            else { err << "Unknown arg: " << a << "\n"; return 1; }
+        }
+        if (file.empty() == p.cmd.empty()) {
+            err << "Usage: tt sync " << sub << " <peer store file> | --cmd=COMMAND\n";
+            return 1;
+        }
+        if (!file.empty()) {
+            std::error_code ec;
+            if (!split_store_file(fs::absolute(file, ec), p.dir, p.name)) {
+                err << "Invalid peer path: " << file << "\n";
+                return 1;
+            }
+            if (!fs::is_directory(p.dir, ec)) { err << "No such directory: " << p.dir.string() << "\n"; return 1; }
+            fs::path theirs;
+            {
+                StoreDirScope scope(p.dir, p.name);
+                theirs = fs::weakly_canonical(data_path(), ec);
+            }
+            if (theirs == fs::weakly_canonical(data_path(), ec)) {
+                err << "The peer is this store.\n";
+                return 1;
+            }
+        }
+        return sync_transfer(sub == "push", p, out, err);
+    }
+    err << "Usage: tt sync init <node> [--nodes=N] | status | pull|push <peer file> | pull|push --cmd=COMMAND\n";
+    return 1;
+}
+
+} // namespace tt
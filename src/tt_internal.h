@@ -0,0 +1,1210 @@
+// internal interface of libtt, shared by its translation units, the tt
+// command and tt_bench. embedders should use <tt/tt.h> instead.
+#pragma once
+
+#include <tt/tt.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TT_HAVE_MMAP 1
+#define TT_HAVE_POSIX_IO 1
+#define TT_HAVE_UNIX_SOCKETS 1
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TT_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+#if (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#define TT_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace tt {
+
+namespace fs = std::filesystem;
+
+// titles of a task collection, packed into a few large blocks instead of
+// one heap allocation per task. views stay valid for the arena's lifetime:
+// blocks are never reallocated, and moving the arena moves only pointers.
+class TitleArena {
+public:
+    void reserve(size_t n) {
+        if (left() < n) grow(n);
+    }
+
+    std::string_view intern(std::string_view s) {
+        if (s.empty()) return {};
+        if (left() < s.size()) grow(s.size());
+        char* p = blocks_.back().get() + used_;
+        std::memcpy(p, s.data(), s.size());
+        used_ += s.size();
+        bytes_ += s.size();
+        return {p, s.size()};
+    }
+
+    size_t bytes() const { return bytes_; }
+
+    // takes over o's blocks, so views into o stay valid and now live here
+    void adopt(TitleArena&& o) {
+        if (o.blocks_.empty()) return;
+        if (blocks_.empty()) { *this = std::move(o); return; }
+        bytes_ += o.bytes_;
+        blocks_.insert(blocks_.end() - 1, std::make_move_iterator(o.blocks_.begin()),
+                       std::make_move_iterator(o.blocks_.end()));
+        o = TitleArena();
+    }
+
+private:
+    static constexpr size_t BLOCK = 1 << 16;
+
+    size_t left() const { return blocks_.empty() ? 0 : cap_ - used_; }
+
+    void grow(size_t n) {
+        cap_ = std::max(n, BLOCK);
+        blocks_.emplace_back(new char[cap_]);
+        used_ = 0;
+    }
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t used_{0}, cap_{0}, bytes_{0};
+};
+
+// a loaded store: the tasks and the arena their titles point into
+struct TaskList {
+    std::vector<Task> tasks;
+    TitleArena titles;
+};
+
+// concatenates parts in order into one list
+TaskList join_lists(std::vector<TaskList>& parts);
+
+// threads: large loads and sorts are split across workers. --threads=N (or
+// TT_THREADS) caps them; 0 means one per core. small stores stay serial.
+extern unsigned g_threads;
+unsigned thread_count();
+
+// runs fn(i) for every i in [0, n), each on its own thread (0 on the caller)
+template <class Fn>
+void parallel_for(size_t n, Fn&& fn) {
+    std::vector<std::thread> pool;
+    pool.reserve(n ? n - 1 : 0);
+    for (size_t i = 1; i < n; ++i) pool.emplace_back([&fn, i]{ fn(i); });
+    if (n) fn(0);
+    for (auto& t : pool) t.join();
+}
+
+// stats: --stats (or TT_STATS=1) reports where a command spent its time on
+// stderr when it exits; --stats=json (TT_STATS=json) prints one JSON object
+// instead. building with -DTT_NO_STATS compiles the probes out entirely.
+enum class Phase { Load, Filter, Sort, Output, Save, Count };
+enum class StatsMode { Off, Text, Json };
+extern StatsMode g_stats;
+
+struct Stats {
+    double ms[static_cast<int>(Phase::Count)]{};
+    uint64_t bytes_read{0}, bytes_written{0}, bytes_out{0};
+    uint64_t tasks{0}, rows{0};
+};
+extern Stats g_stat;
+// heap allocations, counted by the tt binary's operator new
+extern std::atomic<uint64_t> g_allocs;
+
+#ifndef TT_NO_STATS
+// adds the wall time of its scope to one phase
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase p) : p_(p), on_(g_stats != StatsMode::Off) {
+        if (on_) t0_ = std::chrono::steady_clock::now();
+    }
+    ~PhaseTimer() {
+        if (!on_) return;
+        auto t1 = std::chrono::steady_clock::now();
+        g_stat.ms[static_cast<int>(p_)] += std::chrono::duration<double, std::milli>(t1 - t0_).count();
+    }
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    Phase p_;
+    bool on_;
+    std::chrono::steady_clock::time_point t0_;
+};
+
+#define TT_CAT2(a, b) a##b
+#define TT_CAT(a, b) TT_CAT2(a, b)
+#define TT_PHASE(p) PhaseTimer TT_CAT(tt_phase_, __LINE__)(p)
+#define TT_COUNT(field, n) (g_stats != StatsMode::Off ? (void)(g_stat.field += (n)) : (void)0)
+#else
+#define TT_PHASE(p) ((void)0)
+#define TT_COUNT(field, n) ((void)0)
+#endif
+
+bool parse_stats(const std::string& s, StatsMode& m);
+void print_stats(const std::string& cmd, double total_ms, std::ostream& os);
+
+inline bool keep_task(ListFilter f, bool done) {
+    return f == ListFilter::All || (f == ListFilter::Done) == done;
+}
+
+// util
+inline std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\n\r");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\n\r");
+    return s.substr(b, e - b + 1);
+}
+
+inline bool is_blank(std::string_view s) {
+    return s.find_first_not_of(" \t\n\r") == std::string_view::npos;
+}
+
+inline int prio_weight(char p) {
+    switch (p) {
+        case 'H': return 0;
+        case 'M': return 1;
+        case 'L': return 2;
+        default:  return 1;
+    }
+}
+
+// day numbers: days since 0000-03-01 plus one, so 0 can mean "no date".
+// date_to_day and day_to_date are declared in <tt/tt.h>.
+//
+// stores written before dates were checked may hold digit dates that are
+// not on the calendar (2025-02-30, 2025-13-01). new input rejects them, but
+// a loaded one keeps its digits as LEGACY_DAY + YYYYMMDD, past every real
+// day, so it prints and saves as it was; it sorts as the last real date at
+// or before it and falls in no --due-after/--due-before range.
+constexpr uint32_t LEGACY_DAY = 1u << 22;
+// date_to_day, or the legacy encoding for a digit date that is not real; 0
+// for "-" and anything else
+uint32_t stored_day(std::string_view d);
+uint32_t legacy_sort_day(uint32_t n);
+// the day number a due date sorts as
+inline uint32_t sort_day(uint32_t n) {
+    return n < LEGACY_DAY ? n : legacy_sort_day(n);
+}
+// writes the 10 characters of YYYY-MM-DD for day number n
+void format_day(uint32_t n, char* out);
+// day number of the current UTC date
+uint32_t today();
+
+// a real calendar date in YYYY-MM-DD form
+inline bool is_valid_date(const std::string& d) {
+    return date_to_day(d) != 0;
+}
+
+// storage: <list>.tsv / <list>.bin in the store directory, which is the
+// working directory unless g_store_dir is set for the calling thread. the
+// list is "tasks" unless g_store_name names another; every file of a store
+// (journal, lock, sidecars, shard, archive) is named after it.
+constexpr char SEP = '|';
+extern thread_local fs::path g_store_dir;
+extern thread_local std::string g_store_name;
+
+fs::path store_dir();
+std::string store_name();
+// list names become file names: letters, digits, '-', '_' and '.', not
+// leading with a '.'
+bool valid_list_name(std::string_view name);
+// the store directory and list of a data file path, with any .tsv or .bin
+// dropped; false if what is left is not a valid list name
+bool split_store_file(const fs::path& file, fs::path& dir, std::string& name);
+
+// points this thread's store paths at a directory (and list, when given)
+// for the scope's lifetime
+class StoreDirScope {
+public:
+    explicit StoreDirScope(const fs::path& dir, std::string name = std::string())
+        : saved_(std::move(g_store_dir)), saved_name_(std::move(g_store_name)) {
+        g_store_dir = dir;
+        g_store_name = std::move(name);
+    }
+    ~StoreDirScope() {
+        g_store_dir = std::move(saved_);
+        g_store_name = std::move(saved_name_);
+    }
+    StoreDirScope(const StoreDirScope&) = delete;
+    StoreDirScope& operator=(const StoreDirScope&) = delete;
+
+private:
+    fs::path saved_;
+    std::string saved_name_;
+};
+
+fs::path data_path();
+// binary snapshot; when present it is used instead of tasks.tsv
+fs::path bin_path();
+bool use_binary();
+fs::path store_path();
+// done shard: after tt shard, completed tasks are kept apart from the
+// snapshot in tasks.done.tsv (tasks.done.bin beside tasks.bin), so that
+// pending-only reads, add and done never touch them. sharding is on for as
+// long as the file exists.
+fs::path shard_path(bool binary);
+bool sharded();
+std::string encode_field(std::string_view s);
+// splits "id|done|prio|due|title" in place. the title is copied into
+// arena when one is given; otherwise t.title points into line.
+bool parse_task(std::string_view line, Task& t, TitleArena* arena = nullptr);
+// the same, given the offsets of line's first n separators
+bool parse_task_fields(std::string_view line, const uint32_t* seps, unsigned n, Task& t, TitleArena* arena);
+
+#ifdef TT_HAVE_MMAP
+// read-only mapping of a whole file; an empty file maps to an empty view
+class MappedFile {
+public:
+    explicit MappedFile(const fs::path& p) {
+        fd_ = ::open(p.c_str(), O_RDONLY);
+        if (fd_ < 0) return;
+        struct stat st {};
+        if (::fstat(fd_, &st) != 0) return;
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0) { ok_ = true; return; }
+        void* m = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (m == MAP_FAILED) return;
+        data_ = static_cast<const char*>(m);
+        ::madvise(m, size_, MADV_SEQUENTIAL);
+        ok_ = true;
+    }
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool ok() const { return ok_; }
+    std::string_view view() const { return {data_, data_ ? size_ : 0}; }
+
+private:
+    int fd_{-1};
+    const char* data_{nullptr};
+    size_t size_{0};
+    bool ok_{false};
+};
+#endif
+
+// calls fn(std::string_view) for every line of rest with any trailing '\r' removed
+template <class Fn>
+void split_lines(std::string_view rest, Fn&& fn) {
+    while (!rest.empty()) {
+        const void* nl = std::memchr(rest.data(), '\n', rest.size());
+        size_t n = nl ? static_cast<size_t>(static_cast<const char*>(nl) - rest.data()) : rest.size();
+        std::string_view line = rest.substr(0, n);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        fn(line);
+        rest.remove_prefix(nl ? n + 1 : n);
+    }
+}
+
+// calls fn(std::string_view) for every line of p with any trailing '\r'
+// removed. uses a read-only mapping where available, getline otherwise.
+template <class Fn>
+void for_each_line(const fs::path& p, Fn&& fn) {
+#ifdef TT_HAVE_MMAP
+    MappedFile m(p);
+    if (m.ok()) { TT_COUNT(bytes_read, m.view().size()); split_lines(m.view(), fn); return; }
+#endif
+    std::ifstream in(p);
+    std::string line;
+    while (in && std::getline(in, line)) {
+        TT_COUNT(bytes_read, line.size() + 1);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        fn(std::string_view(line));
+    }
+}
+
+// structural scan (scan.cpp): the '|' and '\n' bytes of a 64-byte block
+// as two bitmaps, bit i for byte i, found with the widest vector unit the
+// cpu has. AVX2 is picked at run time; SSE2 and NEON are the baselines of
+// their targets; the plain loop is the fallback. TT_SIMD caps the level.
+enum class ScanLevel { Auto, Scalar, Sse2, Avx2, Neon };
+extern ScanLevel g_scan_level;
+bool parse_scan_level(const std::string& s, ScanLevel& l);
+// the level in use, for --stats and tt_bench
+const char* scan_level_name();
+
+struct ScanMasks {
+    uint64_t sep, nl;
+};
+using ScanBlockFn = ScanMasks (*)(const char* block);
+ScanBlockFn scan_block_fn();
+
+inline unsigned lowest_bit64(uint64_t m) {
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, m);
+    return static_cast<unsigned>(i);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(m));
+#endif
+}
+
+// calls fn(line, seps, n) for each line of buf, as split_lines would cut
+// them, with the offsets in line of its first n separators (n <= 5: enough
+// for the five fields of a task line). blocks are scanned a whole 64 bytes
+// at a time, the last through a zero-padded copy.
+template <class Fn>
+void for_each_tsv_line(std::string_view buf, Fn&& fn) {
+    const ScanBlockFn scan = scan_block_fn();
+    const char* p = buf.data();
+    const size_t size = buf.size();
+    uint32_t seps[5];
+    unsigned n = 0;
+    size_t start = 0;
+    auto line = [&](size_t end) {
+        std::string_view l(p + start, end - start);
+        if (!l.empty() && l.back() == '\r') l.remove_suffix(1);
+        fn(l, static_cast<const uint32_t*>(seps), n);
+    };
+    for (size_t at = 0; at < size; at += 64) {
+        ScanMasks m;
+        if (size - at >= 64) {
+            m = scan(p + at);
+        } else {
+            char pad[64] = {};
+            std::memcpy(pad, p + at, size - at);
+            m = scan(pad);
+        }
+        for (uint64_t bits = m.sep | m.nl; bits; bits &= bits - 1) {
+            const unsigned i = lowest_bit64(bits);
+            const size_t pos = at + i;
+            if (m.nl >> i & 1) {
+                line(pos);
+                start = pos + 1;
+                n = 0;
+            } else if (n < 5) {
+                seps[n++] = static_cast<uint32_t>(pos - start);
+            }
+        }
+    }
+    if (start < size) line(size);
+}
+
+// calls fn(std::string_view) with the whole contents of p; false if unreadable
+template <class Fn>
+bool with_file_view(const fs::path& p, Fn&& fn) {
+#ifdef TT_HAVE_MMAP
+    MappedFile m(p);
+    if (m.ok()) { TT_COUNT(bytes_read, m.view().size()); fn(m.view()); return true; }
+#endif
+    std::ifstream in(p, std::ios::binary);
+    if (!in) return false;
+    std::string buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    TT_COUNT(bytes_read, buf.size());
+    fn(std::string_view(buf));
+    return true;
+}
+
+// durability of writes, chosen with --sync=MODE or TT_SYNC:
+//   none    never fsync; snapshots are still replaced atomically
+//   close   fsync each file once its write is finished. batch and serve
+//           group their mutations into one journal append and one fsync
+//   always  like close, but batch and serve commit after every command
+enum class SyncMode { None, Close, Always };
+extern SyncMode g_sync;
+
+bool parse_sync(const std::string& s, SyncMode& m);
+
+enum class WriteMode { Truncate, Append, Patch };
+
+// writes n bytes to p (at off for Patch), fsyncing per g_sync
+bool write_at(const fs::path& p, WriteMode mode, uint64_t off, const char* data, size_t n);
+bool append_file(const fs::path& p, const std::string& data);
+bool patch_bytes(const fs::path& p, uint64_t off, const void* data, size_t n);
+// write-to-temp then rename, so readers and crashes only ever see either
+// the old or the new file. the directory is synced too unless mode is none.
+// private_tmp names the temp file after the process, for callers that only
+// hold a shared lock and may race another reader writing the same file.
+bool replace_file(const fs::path& p, const std::string& data, bool private_tmp = false);
+
+// locking: an advisory lock on <data file>.lock covers every load->save
+// window, shared for readers and exclusive for writers. the lock file is
+// never replaced, unlike the snapshot, so it survives atomic renames.
+// with --lock-free (or TT_LOCK_FREE=1) list/export don't wait behind a
+// writer and read the last committed snapshot plus complete journal records.
+extern bool g_lock_free;
+
+fs::path lock_path();
+
+class FileLock {
+public:
+    enum Kind { Shared, Exclusive };
+
+    FileLock() = default;
+    ~FileLock() { release(); }
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    // false if the lock is held elsewhere (wait == false) or can't be taken
+    bool acquire(Kind k, bool wait) {
+        release();
+#if defined(TT_HAVE_POSIX_IO)
+        fd_ = ::open(lock_path().c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ < 0) return false;
+        int op = (k == Exclusive ? LOCK_EX : LOCK_SH) | (wait ? 0 : LOCK_NB);
+        int r;
+        do { r = ::flock(fd_, op); } while (r != 0 && errno == EINTR);
+        if (r != 0) { release(); return false; }
+#elif defined(_WIN32)
+        fd_ = ::_wopen(lock_path().c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+        if (fd_ < 0) return false;
+        HANDLE h = reinterpret_cast<HANDLE>(::_get_osfhandle(fd_));
+        OVERLAPPED ov{};
+        DWORD flags = (k == Exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0) | (wait ? 0 : LOCKFILE_FAIL_IMMEDIATELY);
+        if (!::LockFileEx(h, flags, 0, MAXDWORD, MAXDWORD, &ov)) { release(); return false; }
+#else
+        (void)k; (void)wait;
+        fd_ = 0;
+#endif
+        return true;
+    }
+
+    void release() {
+        if (fd_ < 0) return;
+#if defined(TT_HAVE_POSIX_IO)
+        ::flock(fd_, LOCK_UN);
+        ::close(fd_);
+#elif defined(_WIN32)
+        OVERLAPPED ov{};
+        ::UnlockFileEx(reinterpret_cast<HANDLE>(::_get_osfhandle(fd_)), 0, MAXDWORD, MAXDWORD, &ov);
+        ::_close(fd_);
+#endif
+        fd_ = -1;
+    }
+
+    bool held() const { return fd_ >= 0; }
+
+private:
+    int fd_{-1};
+};
+
+// lock for a read-only command, honouring --lock-free
+void lock_for_read(FileLock& lk);
+
+// tasks.bin layout (native little-endian):
+//   header  "TTB1", u32 version, u32 record count, u32 heap size
+//   records fixed 20 bytes each: i32 id, u8 flags, 3 pad, u32 due day,
+//           u32 title offset, u32 title length
+//   heap    concatenated titles
+// flags bit 0 is done, bits 1-2 the priority weight. records can be
+// filtered on flags/due without touching the heap.
+static const char BIN_MAGIC[4] = {'T', 'T', 'B', '1'};
+static const uint32_t BIN_VERSION = 1;
+static const size_t BIN_HEADER = 16;
+static const size_t BIN_RECORD = 20;
+
+struct BinRecord {
+    int32_t id;
+    uint8_t flags;
+    uint32_t due;
+    uint32_t title_off;
+    uint32_t title_len;
+};
+
+inline uint32_t get_u32(const char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+inline void put_u32(std::string& out, uint32_t v) { out.append(reinterpret_cast<const char*>(&v), 4); }
+
+inline BinRecord read_record(const char* p) {
+    BinRecord r;
+    std::memcpy(&r.id, p, 4);
+    r.flags = static_cast<uint8_t>(p[4]);
+    r.due = get_u32(p + 8);
+    r.title_off = get_u32(p + 12);
+    r.title_len = get_u32(p + 16);
+    return r;
+}
+
+void load_binary(const fs::path& p, TaskList& l, ListFilter keep);
+bool save_binary(const fs::path& p, const std::vector<Task>& v);
+void write_task(std::ostream& out, const Task& t);
+
+// journal: append-only log of mutations replayed over the snapshot.
+// records are "+|<task line>" (add), "x|<id>" (done) and "-|<id>" (rm).
+// replay is idempotent, so a crash between writing a new snapshot and
+// removing the log only replays operations that are already folded in.
+fs::path journal_path();
+
+// calls fn(std::string_view) for each complete journal record. a final
+// line without its '\n' is a write still in progress (or torn by a crash)
+// and is skipped.
+template <class Fn>
+void for_each_record(Fn&& fn) {
+    std::error_code ec;
+    if (!fs::exists(journal_path(), ec)) return;
+    with_file_view(journal_path(), [&](std::string_view buf) {
+        size_t end = buf.rfind('\n');
+        if (end == std::string_view::npos) return;
+        buf = buf.substr(0, end + 1);
+        while (!buf.empty()) {
+            size_t nl = buf.find('\n');
+            std::string_view line = buf.substr(0, nl);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            fn(line);
+            buf.remove_prefix(nl + 1);
+        }
+    });
+}
+
+void replay_journal(TaskList& l);
+std::string journal_add_record(const Task& t);
+std::string journal_id_record(char op, int id);
+// appends complete records, first terminating a torn final line so the new
+// records don't get glued onto it
+bool append_records(const std::string& recs);
+bool append_journal(const std::string& rec);
+
+TaskList load_tsv(const fs::path& p);
+bool save_tsv(const fs::path& p, const std::vector<Task>& v);
+
+// sidecar index <store>.idx, so done/rm/add don't have to load the store:
+//   header  "TTI1", u32 version, u64 snapshot size, i64 snapshot mtime,
+//           i32 highest id ever assigned, u32 entry count
+//   entries 16 bytes each, sorted by id: i32 id, u32 reserved, u64 offset
+//           of the record's done byte in the snapshot
+// the size/mtime signature ties the index to one snapshot. done patches the
+// byte in place and re-signs, rm tombstones the entry (and journals the
+// removal), add bumps the stored max id.
+fs::path index_path();
+
+static const char IDX_MAGIC[4] = {'T', 'T', 'I', '1'};
+static const uint32_t IDX_VERSION = 1;
+static const size_t IDX_HEADER = 32;
+static const size_t IDX_ENTRY = 16;
+static const uint64_t IDX_DEAD = UINT64_MAX;        // removed through the journal
+static const uint64_t IDX_NOPATCH = UINT64_MAX - 1; // live, but done must go to the journal
+
+struct IndexHeader {
+    uint64_t snap_size{0};
+    int64_t snap_mtime{0};
+    int32_t max_id{0};
+    uint32_t count{0};
+};
+
+struct IndexHit {
+    size_t pos;
+    uint64_t off;
+};
+
+void snapshot_sig(uint64_t& size, int64_t& mtime);
+bool parse_journal_id(std::string_view rest, int& id);
+// reads the header; false if missing or corrupt. stale tells whether it no
+// longer matches the snapshot on disk.
+bool read_index_header(IndexHeader& h, bool& stale);
+// rescans the snapshot for done-byte offsets and the journal for removals
+// and added ids. min_max_id keeps ids from being reused after compaction.
+void build_index(int32_t min_max_id);
+// header of a current index, rebuilding it first if it is missing or stale
+bool open_index(IndexHeader& h);
+std::optional<IndexHit> index_find(int id);
+// raises the id high-water mark. callers raise it before journaling a new
+// id, so a crash in between can only skip an id, never hand it out twice
+bool index_set_max(int32_t max_id);
+void index_tombstone(size_t pos);
+// entry pos now lives in the journal: done can no longer patch its record
+void index_unpatchable(size_t pos);
+// flips the done byte of a snapshot record in place and re-signs the index
+bool patch_done(uint64_t off);
+// whether a task is live once the journal is replayed; in_snapshot tells
+// whether a snapshot holds it without the index knowing (the done shard)
+bool journal_has(int id, bool in_snapshot = false);
+
+// ids: a new task takes the highest id yet plus one. a store that syncs
+// with others (tt sync init) is one of `nodes` numbered nodes and takes only
+// ids whose remainder mod nodes is its own number, so nodes adding at the
+// same time never hand out the same id.
+struct IdSpace {
+    int32_t node{0}, nodes{1};
+};
+
+// this store's id space, from <store>.sync/node; max + 1 when there is none
+IdSpace id_space();
+
+// the first id of s past max_id
+inline int32_t next_id(int32_t max_id, const IdSpace& s) {
+    const int32_t n = max_id + 1;
+    return n + ((s.node - n % s.nodes) % s.nodes + s.nodes) % s.nodes;
+}
+
+// keep only affects which tasks are returned. the binary loader can skip
+// non-matching records before reading their titles, but only when there is
+// no journal that could still change their done flag.
+TaskList load_tasks(ListFilter keep = ListFilter::All);
+// rewrites the snapshot with the journal folded in, then drops the journal
+// on failure the old snapshot and journal are left untouched
+bool save_tasks(const std::vector<Task>& v);
+// the same, turning the done shard on or off
+bool save_tasks(const std::vector<Task>& v, bool shard);
+// writes v as the snapshot in the given format; with shard, the completed
+// tasks go to the done shard instead
+bool write_snapshot(const std::vector<Task>& v, bool binary, bool shard);
+// whether the done shard holds a task with this id that the journal has
+// not removed
+bool shard_has(int id);
+// done shard tasks passing match, less those the journal removed or
+// replaced; the journal's own adds are search_tasks' to return
+void scan_shard(TaskList& l, const std::function<bool(const Task&)>& match);
+
+// archive (archive.cpp): completed tasks moved out of the store for good,
+// into tasks.archive, a file of compressed blocks that is only ever
+// appended to. archived tasks are read-only and only read on request.
+fs::path archive_path();
+// --archive-after=N (or TT_ARCHIVE_AFTER): every snapshot rewrite archives
+// the completed tasks due more than N days ago. -1 leaves them alone.
+extern int g_archive_after;
+// appends the tasks of v that are done and, unless before is 0, due before
+// that day; the others go to rest. false if the archive can't be written.
+bool archive_tasks(const std::vector<Task>& v, uint32_t before, std::vector<Task>& rest, size_t& moved);
+// archived tasks passing match, decompressed a block at a time; ids that
+// l already holds, or that were archived twice, are skipped
+void scan_archive(TaskList& l, const std::function<bool(const Task&)>& match);
+// the highest id in the archive, from the block headers alone
+int32_t archive_max_id();
+
+// search: tt find looks words up in <store>.fts, an inverted index over the
+// snapshot's titles; tt list --due-after/--due-before uses <store>.due, the
+// snapshot's dated tasks sorted by day. both cover only the snapshot, are
+// rebuilt when its signature changes, and have the journal replayed over
+// their hits. layouts are described in search.cpp.
+fs::path search_path();
+fs::path due_index_path();
+
+// one query word; "foo*" matches every word starting with foo
+struct SearchTerm {
+    std::string word;
+    bool prefix{false};
+};
+
+std::vector<SearchTerm> parse_query(const std::vector<std::string>& words);
+// every term matches some word of title
+bool title_matches(std::string_view title, const std::vector<SearchTerm>& q);
+// first occurrence of needle in hay at or after from, exact bytes
+size_t find_substr(std::string_view hay, std::string_view needle, size_t from = 0);
+
+// a tasks.bin image whose header and sizes are consistent
+bool bin_valid(std::string_view buf);
+// the task whose line (tsv) or record (tasks.bin) starts at off; the title
+// points into buf
+bool snapshot_task_at(std::string_view buf, bool binary, uint64_t off, Task& t);
+
+// calls fn(const Task&, uint64_t offset) for each task of a snapshot image
+template <class Fn>
+void for_each_snapshot_task(std::string_view buf, bool binary, Fn&& fn) {
+    Task t;
+    if (binary) {
+        if (!bin_valid(buf)) return;
+        const uint32_t count = get_u32(buf.data() + 8);
+        for (uint32_t i = 0; i < count; ++i) {
+            size_t at = BIN_HEADER + static_cast<size_t>(i) * BIN_RECORD;
+            if (snapshot_task_at(buf, true, at, t)) fn(t, at);
+        }
+        return;
+    }
+    size_t at = 0;
+    while (at < buf.size()) {
+        size_t nl = buf.find('\n', at);
+        if (nl == std::string_view::npos) nl = buf.size();
+        if (snapshot_task_at(buf, false, at, t)) fn(t, at);
+        at = nl + 1;
+    }
+}
+
+// calls fn(int id) for each task of a snapshot image, reading nothing but
+// the ids; lines that are not tasks may still yield one
+template <class Fn>
+void for_each_snapshot_id(std::string_view buf, bool binary, Fn&& fn) {
+    if (binary) {
+        if (!bin_valid(buf)) return;
+        const uint32_t count = get_u32(buf.data() + 8);
+        for (uint32_t i = 0; i < count; ++i) {
+            int32_t id;
+            std::memcpy(&id, buf.data() + BIN_HEADER + static_cast<size_t>(i) * BIN_RECORD, 4);
+            fn(id);
+        }
+        return;
+    }
+    split_lines(buf, [&](std::string_view line) {
+        const char* b = line.data();
+        const char* e = b + line.size();
+        while (b < e && (*b == ' ' || *b == '\t')) ++b;
+        int id;
+        auto r = std::from_chars(b, e, id);
+        if (r.ec == std::errc() && r.ptr < e && *r.ptr == SEP) fn(id);
+    });
+}
+
+bool search_index_current();
+void build_search_index();
+bool due_index_current();
+void build_due_index();
+// after done patched the snapshot in place, titles, dates and offsets are
+// unchanged, so sidecars that matched the old signature move to the new one
+void resign_sidecars(uint64_t old_size, int64_t old_mtime, const char* sig);
+
+// snapshot offsets of tasks whose titles contain every term, from the .fts
+std::vector<uint64_t> search_offsets(const std::vector<SearchTerm>& q);
+// snapshot offsets of tasks whose titles contain needle, by scanning buf
+std::vector<uint64_t> substr_offsets(std::string_view buf, bool binary, std::string_view needle);
+// snapshot offsets of tasks due in [from, to), from the .due
+std::vector<uint64_t> due_offsets(uint32_t from, uint32_t to);
+// snapshot tasks at offs with the journal replayed over them, keeping those
+// that still satisfy match, tasks added through the journal included
+TaskList search_tasks(const std::vector<uint64_t>& offs, std::string_view buf, bool binary,
+                      const std::function<bool(const Task&)>& match);
+
+// filters: the conditions of tt list, shared by done --where and rm --where
+// so a selection previews exactly what a bulk mutation will touch
+struct FilterProgram;
+
+struct TaskFilter {
+    ListFilter state{ListFilter::All};
+    uint8_t prio_mask{7};                  // bit per prio_weight
+    uint32_t due_from{0}, due_to{0};       // [from, to), 0 = open; a bound drops undated tasks
+    std::vector<std::pair<int, int>> ids;  // inclusive id ranges, sorted and disjoint
+    std::vector<SearchTerm> words;         // must all match the title, as in tt find
+
+    TaskFilter() = default;
+    TaskFilter(ListFilter s) : state(s) {}
+
+    // any condition besides state
+    bool narrowed() const;
+    // reduced once to what the per-row loops test
+    FilterProgram compile() const;
+    // for one-off checks; loops should compile() first
+    bool matches(const Task& t) const;
+    // the id and title conditions alone
+    bool matches_rest(const Task& t) const;
+};
+
+// a compiled TaskFilter. state, priority and the due range fold into one
+// table lookup and one unsigned compare on a packed word, however many of
+// them are given; ids and title words, the costlier checks, only run for
+// rows that pass that and only when present.
+struct FilterProgram {
+    uint8_t lut;               // bit (prio weight << 1 | done) set for admitted rows
+    uint32_t lo, span;         // due - lo < span; undated (0) wraps and fails any bound
+    const TaskFilter* rest;    // set when ids or words must be checked too
+
+    static uint32_t pack(const Task& t) {
+        return t.due << 3 | static_cast<uint32_t>(prio_weight(t.priority)) << 1 | (t.done ? 1u : 0u);
+    }
+    bool admits(uint32_t c) const { return ((lut >> (c & 7)) & 1) & ((c >> 3) - lo < span); }
+    bool matches(const Task& t) const { return admits(pack(t)) && (!rest || rest->matches_rest(t)); }
+};
+
+// consumes the filter option at args[i] (and its value, advancing i).
+// 1 if it was one, 0 if args[i] is something else, -1 with error set for a
+// bad value
+int parse_filter_arg(const std::vector<std::string>& args, size_t& i, TaskFilter& f, std::string& error);
+
+// printing: rows are formatted into one reusable buffer that goes out in
+// large chunks, instead of streaming every field through std::cout
+enum class OutFormat { Table, Tsv, Json, Ndjson, Csv };
+
+bool parse_format(const std::string& s, OutFormat& f);
+
+class TaskWriter {
+public:
+    explicit TaskWriter(OutFormat f, std::ostream& os = std::cout) : fmt_(f), os_(os) {
+        buf_.reserve(CHUNK + 4096);
+        if (fmt_ == OutFormat::Json) buf_ += '[';
+        if (fmt_ == OutFormat::Csv) buf_ += "id,done,priority,due,title\n";
+    }
+    ~TaskWriter() {
+        if (fmt_ == OutFormat::Json) buf_ += rows_ ? "\n]\n" : "]\n";
+        flush();
+        TT_COUNT(rows, rows_);
+    }
+    TaskWriter(const TaskWriter&) = delete;
+    TaskWriter& operator=(const TaskWriter&) = delete;
+
+    void write(const Task& t) {
+        switch (fmt_) {
+            case OutFormat::Table:
+                put_id_padded(t.id);
+                buf_ += t.done ? "  [x]  " : "  [ ]  ";
+                buf_ += t.priority;
+                buf_ += "  ";
+                if (t.due) put_day(t.due); else buf_ += "--";
+                buf_ += "  ";
+                buf_ += t.title;
+                buf_ += '\n';
+                break;
+            case OutFormat::Tsv:
+                put_int(t.id);
+                buf_ += SEP;
+                buf_ += t.done ? '1' : '0';
+                buf_ += SEP;
+                buf_ += t.priority;
+                buf_ += SEP;
+                if (t.due) put_day(t.due); else buf_ += '-';
+                buf_ += SEP;
+                buf_ += encode_field(t.title);
+                buf_ += '\n';
+                break;
+            case OutFormat::Json:
+            case OutFormat::Ndjson:
+                if (fmt_ == OutFormat::Json) buf_ += rows_ ? ",\n" : "\n";
+                buf_ += '{';
+                put_json_fields(t);
+                buf_ += '}';
+                if (fmt_ == OutFormat::Ndjson) buf_ += '\n';
+                break;
+            case OutFormat::Csv:
+                put_int(t.id);
+                buf_ += t.done ? ",1," : ",0,";
+                buf_ += t.priority;
+                buf_ += ',';
+                if (t.due) put_day(t.due);
+                buf_ += ',';
+                put_csv_field(t.title);
+                buf_ += '\n';
+                break;
+        }
+        ++rows_;
+        if (buf_.size() >= CHUNK) flush();
+    }
+
+    // one ndjson line for tt watch: {"event":kind, then the task's fields}
+    void event(std::string_view kind, const Task& t) {
+        buf_ += "{\"event\":\"";
+        buf_ += kind;
+        buf_ += "\",";
+        put_json_fields(t);
+        buf_ += "}\n";
+        ++rows_;
+        if (buf_.size() >= CHUNK) flush();
+    }
+
+    void flush() {
+        if (buf_.empty()) return;
+        TT_COUNT(bytes_out, buf_.size());
+        os_.write(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+        os_.flush();
+        buf_.clear();
+    }
+
+private:
+    static constexpr size_t CHUNK = 1 << 16;
+
+    void put_int(int v) {
+        char tmp[16];
+        auto r = std::to_chars(tmp, tmp + sizeof tmp, v);
+        buf_.append(tmp, static_cast<size_t>(r.ptr - tmp));
+    }
+
+    // right-aligned in a 3-wide column like the original table
+    void put_id_padded(int v) {
+        char tmp[16];
+        auto r = std::to_chars(tmp, tmp + sizeof tmp, v);
+        size_t n = static_cast<size_t>(r.ptr - tmp);
+        if (n < 3) buf_.append(3 - n, ' ');
+        buf_.append(tmp, n);
+    }
+
+    void put_day(uint32_t day) {
+        char tmp[10];
+        format_day(day, tmp);
+        buf_.append(tmp, 10);
+    }
+
+    void put_json_fields(const Task& t) {
+        buf_ += "\"id\":";
+        put_int(t.id);
+        buf_ += t.done ? ",\"done\":true" : ",\"done\":false";
+        buf_ += ",\"priority\":\"";
+        buf_ += t.priority;
+        buf_ += "\",\"due\":";
+        if (t.due) { buf_ += '"'; put_day(t.due); buf_ += '"'; } else buf_ += "null";
+        buf_ += ",\"title\":";
+        put_json_string(t.title);
+    }
+
+    void put_json_string(std::string_view s) {
+        static const char hex[] = "0123456789abcdef";
+        buf_ += '"';
+        for (char c : s) {
+            unsigned char u = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') { buf_ += '\\'; buf_ += c; }
+            else if (u < 0x20) { buf_ += "\\u00"; buf_ += hex[u >> 4]; buf_ += hex[u & 15]; }
+            else buf_ += c;
+        }
+        buf_ += '"';
+    }
+
+    // quoted only when it has to be, doubling embedded quotes (RFC 4180)
+    void put_csv_field(std::string_view s) {
+        bool plain = s.find_first_of(",\"\r\n") == std::string_view::npos;
+        if (plain && (s.empty() || (s.front() != ' ' && s.back() != ' '))) {
+            buf_ += s;
+            return;
+        }
+        buf_ += '"';
+        for (char c : s) {
+            if (c == '"') buf_ += '"';
+            buf_ += c;
+        }
+        buf_ += '"';
+    }
+
+    OutFormat fmt_;
+    std::ostream& os_;
+    std::string buf_;
+    size_t rows_{0};
+};
+
+// the journal summarised for streaming over a snapshot, as export and the
+// streaming list do. mirrors replay_journal: an add of a live id replaces
+// that task where it stands, an add of a removed id is a new task at the end
+struct JournalOverlay {
+    TitleArena titles;
+    std::vector<Task> adds;              // in journal order
+    std::vector<char> add_live;
+    std::vector<char> add_in_place;      // replaces the snapshot task with its id
+    std::unordered_map<int, size_t> add_pos;
+    std::unordered_set<int> done, dead;  // applied to snapshot tasks
+};
+
+JournalOverlay read_overlay();
+// calls fn for each live task that keep admits, in the order load_tasks
+// would return them, without loading the store
+void for_each_live_task(ListFilter keep, const std::function<void(const Task&)>& fn);
+
+// bulk transfer (bulk.cpp). export_tasks streams the live tasks to w in
+// load order without loading them; import_tasks loads the store, adds csv or
+// ndjson rows from in as new tasks in memory and saves once, or writes
+// nothing and explains in error. both expect the caller to hold the
+// matching lock.
+void export_tasks(TaskWriter& w);
+bool import_tasks(std::istream& in, bool csv, size_t& added, std::string& error);
+
+// sorting: each task gets one packed 64-bit key, resolved once up front, so
+// the sort itself is a plain integer compare. see output.cpp.
+SortKey parse_sort_key(const std::string& s);
+
+struct SortEntry {
+    uint64_t key;
+    uint32_t idx;   // position in the loaded vector; keeps the order stable
+};
+
+inline bool operator<(const SortEntry& a, const SortEntry& b) {
+    return a.key != b.key ? a.key < b.key : a.idx < b.idx;
+}
+
+// sorted positions of the tasks that pass filter, with offset/limit applied.
+// limit 0 means unlimited.
+std::vector<SortEntry> sort_tasks(const std::vector<Task>& v, SortKey k, const TaskFilter& filter = TaskFilter(),
+                                  size_t offset = 0, size_t limit = 0);
+void list_cmd(const std::vector<Task>& v, const TaskFilter& filter, SortKey sort_key, size_t offset, size_t limit,
+              OutFormat fmt, std::ostream& os);
+
+// streaming list (stream.cpp). stream_list writes the --sort=id listing
+// while reading the store files, returning false, with nothing written, if
+// the snapshot is not in id order. external_list sorts in runs of about
+// mem_limit bytes spilled next to the store and merges them, returning
+// false, with nothing written, if a run can't be written. neither takes the
+// due-range fast path; the caller holds the read lock.
+bool stream_list(const TaskFilter& f, size_t offset, size_t limit, OutFormat fmt, std::ostream& os);
+bool external_list(const TaskFilter& f, SortKey k, size_t offset, size_t limit, size_t mem_limit, OutFormat fmt,
+                   std::ostream& os);
+// bytes of the store files a listing of keep would read
+size_t list_bytes(ListFilter keep);
+
+// what the store files looked like when last read or written; a change
+// means another process has written since
+struct DiskSig {
+    bool binary{false};
+    uint64_t snap_size{0}, log_size{0};
+    int64_t snap_mtime{0}, log_mtime{0};
+
+    bool operator==(const DiskSig& o) const {
+        return binary == o.binary && snap_size == o.snap_size && snap_mtime == o.snap_mtime &&
+               log_size == o.log_size && log_mtime == o.log_mtime;
+    }
+    bool operator!=(const DiskSig& o) const { return !(*this == o); }
+    // the snapshot is the same file, whatever the journal did
+    bool same_snapshot(const DiskSig& o) const {
+        return binary == o.binary && snap_size == o.snap_size && snap_mtime == o.snap_mtime;
+    }
+};
+
+DiskSig disk_sig();
+
+// list view cache: the complete output of a plain list, kept per (filter,
+// sort, format) in <store>.views/ and stamped with the DiskSig it was
+// rendered from
+fs::path view_path(ListFilter filter, SortKey key, OutFormat fmt);
+bool view_pageable(OutFormat fmt, size_t offset, size_t limit);
+// writes the cached page to os if the view at p was rendered from sig
+bool serve_view(const fs::path& p, const DiskSig& sig, size_t offset, size_t limit, std::ostream& os);
+// renders the full listing, stores it as a view if the store did not change
+// while it was read, and writes the requested page to os
+void list_and_cache(ListFilter filter, SortKey key, size_t offset, size_t limit, OutFormat fmt,
+                    const DiskSig& before, std::ostream& os);
+
+// in-memory store for running many commands against a single load (tt
+// batch, tt serve). mutations update the vector and queue journal records;
+// flush() writes them in one append, or one snapshot rewrite after
+// clear/compact. removed tasks are only flagged until the next live() so
+// repeated rm calls don't shift the whole vector.
+//
+// unless the caller holds the exclusive lock throughout (held_lock), flush
+// locks for itself and merges optimistically: if another process wrote in
+// the meantime the store is reloaded and the queued operations replayed on
+// top, renumbering adds whose id was taken concurrently.
+struct Store {
+    std::vector<Task> tasks;
+    TitleArena titles;
+    std::vector<char> removed;
+    std::unordered_map<int, size_t> pos;
+    int32_t max_id{0};
+    std::string pending;            // journal records, plus "C|..." for clears
+    bool rewrite{false};
+    bool held_lock{false};
+    DiskSig sig;
+    IdSpace ids;
+
+    // the caller is expected to hold at least a shared lock
+    static Store open();
+    // picks up writes by other processes while nothing is queued
+    void refresh();
+    void reindex();
+
+    Task* find(int id) {
+        auto it = pos.find(id);
+        if (it == pos.end() || removed[it->second]) return nullptr;
+        return &tasks[it->second];
+    }
+
+    const std::vector<Task>& live();
+    int add(Task t);
+    // adds t under its own id, which must not be live
+    void insert(Task t);
+    bool mark_done(int id);
+    bool remove(int id);
+    void clear(bool all);
+    // notes of adds renumbered on the way go to *err when given
+    void merge(std::ostream* err);
+    // false if nothing could be written; the changes stay queued
+    bool flush(std::ostream* err = nullptr);
+
+    bool dirty() const { return rewrite || !pending.empty(); }
+};
+
+// open stores kept by path, most recently used first, for processes that
+// host many lists (tt serve, tt::StorePool). put makes room by offering the
+// least recently used entries to evict, which declines one it can't let go
+// of yet (changes it failed to write); then the cache runs over capacity
+// until a later put.
+template <class V>
+class LruCache {
+public:
+    explicit LruCache(size_t capacity) : cap_(std::max<size_t>(capacity, 1)) {}
+
+    // the entry for key, now the most recently used; nullptr if absent
+    V* get(const std::string& key) {
+        auto it = pos_.find(key);
+        if (it == pos_.end()) return nullptr;
+        items_.splice(items_.begin(), items_, it->second);
+        return &it->second->second;
+    }
+
+    template <class Evict>
+    V& put(const std::string& key, V v, Evict&& evict) {
+        for (auto it = items_.end(); items_.size() >= cap_ && it != items_.begin();) {
+            --it;
+            if (!evict(it->second)) continue;
+            pos_.erase(it->first);
+            it = items_.erase(it);
+        }
+        items_.emplace_front(key, std::move(v));
+        pos_[key] = items_.begin();
+        return items_.front().second;
+    }
+
+    template <class Fn>
+    void for_each(Fn&& fn) {
+        for (auto& item : items_) fn(item.second);
+    }
+
+    size_t size() const { return items_.size(); }
+
+private:
+    size_t cap_;
+    std::list<std::pair<std::string, V>> items_;
+    std::unordered_map<std::string, typename std::list<std::pair<std::string, V>>::iterator> pos_;
+};
+
+// commands
+void help(std::ostream& out);
+int parse_int(const std::string& s);
+// splits a batch line into words: whitespace separates, '...' and "..."
+// group, backslash escapes outside single quotes. false on an open quote.
+bool split_args(const std::string& line, std::vector<std::string>& out);
+// commands that work on the store's files as a whole (or run their own
+// loop) and so never run against an in-memory Store: batch and serve refuse
+// them, and the TT_SOCKET client runs them itself instead of forwarding
+bool whole_store_command(const std::string& cmd);
+// runs one command. args[0] is the command name. with st set the command
+// works on that in-memory store; otherwise it goes straight to disk.
+int run_command(const std::vector<std::string>& args, Store* st, std::ostream& out, std::ostream& err);
+int batch_cmd(std::istream& in, std::ostream& out, std::ostream& err);
+int serve_cmd(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+// follows the store and prints its changes as ndjson events until stopped
+int watch_cmd(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+// replicates the list with other copies of it (sync.cpp)
+int sync_cmd(const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
+#ifdef TT_HAVE_UNIX_SOCKETS
+// forwards one command line to a running tt serve
+int client_cmd(const fs::path& sock, const std::vector<std::string>& args);
+#endif
+
+} // namespace tt
@@ -0,0 +1,157 @@
+// tt watch: follows a store and prints each change as an ndjson event
+#include "tt_internal.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace tt {
+
+// events, one per line, carry the task as list --format=ndjson prints it:
+//   {"event":"add","id":7,"done":false,"priority":"H","due":null,"title":"..."}
+// with "add", "done" or "remove". journal appends are read incrementally;
+// anything that rewrites or patches the snapshot (compact, clear, done on a
+// snapshot task, shard, archive) is picked up by reloading the store and
+// diffing it against the tasks seen so far.
+static volatile std::sig_atomic_t g_watch_stop = 0;
+
+static void on_watch_signal(int) { g_watch_stop = 1; }
+
+struct WatchState {
+    std::unordered_map<int, Task> live;
+    TitleArena titles;
+    DiskSig sig;          // snapshot as of the last reload
+    uint64_t log_read{0}; // journal bytes already turned into events
+};
+
+static void reload(WatchState& s, const DiskSig& now, bool quiet, TaskWriter& w) {
+    TaskList fresh = load_tasks();
+    std::unordered_map<int, Task> next;
+    next.reserve(fresh.tasks.size());
+    for (const Task& t : fresh.tasks) {
+        next[t.id] = t;
+        if (quiet) continue;
+        auto it = s.live.find(t.id);
+        if (it == s.live.end()) w.event("add", t);
+        else if (t.done && !it->second.done) w.event("done", t);
+    }
+    if (!quiet) {
+        std::vector<int> gone;
+        for (const auto& e : s.live)
+            if (!next.count(e.first)) gone.push_back(e.first);
+        std::sort(gone.begin(), gone.end());
+        for (int id : gone) w.event("remove", s.live[id]);
+    }
+    s.live = std::move(next);
+    s.titles = std::move(fresh.titles);
+    s.sig = now;
+    s.log_read = now.log_size;
+}
+
+// events for the complete journal records past log_read
+static void tail(WatchState& s, uint64_t size, TaskWriter& w) {
+    std::ifstream in(journal_path(), std::ios::binary);
+    in.seekg(static_cast<std::streamoff>(s.log_read));
+    std::string buf(static_cast<size_t>(size - s.log_read), '\0');
+    if (!in.read(&buf[0], static_cast<std::streamsize>(buf.size()))) return;
+    // a record still being written is left for the next round
+    const size_t end = buf.rfind('\n');
+    if (end == std::string::npos) return;
+    s.log_read += end + 1;
+    split_lines(std::string_view(buf).substr(0, end + 1), [&](std::string_view line) {
+        if (line.size() < 3 || line[1] != SEP) return;
+        std::string_view rest = line.substr(2);
+        int id = 0;
+        if (line[0] == '+') {
+            Task t;
+            if (!parse_task(rest, t, &s.titles)) return;
+            s.live[t.id] = t;
+            w.event("add", t);
+        } else if ((line[0] == 'x' || line[0] == '-') && parse_journal_id(rest, id)) {
+            auto it = s.live.find(id);
+            if (it == s.live.end()) return;
+            if (line[0] == '-') {
+                w.event("remove", it->second);
+                s.live.erase(it);
+            } else if (!it->second.done) {
+                it->second.done = true;
+                w.event("done", it->second);
+            }
+        }
+    });
+}
+
+static void check(WatchState& s, bool first, bool initial, TaskWriter& w) {
+    FileLock lk;
+    lock_for_read(lk);
+    const DiskSig now = disk_sig();
+    if (first || !now.same_snapshot(s.sig) || now.log_size < s.log_read) reload(s, now, first && !initial, w);
+    else if (now.log_size > s.log_read) tail(s, now.log_size, w);
+    w.flush();
+}
+
+int watch_cmd(const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    bool initial = false;
+    int poll_ms = 1000;
+    for (size_t i = 1; i < args.size(); ++i) {
+        const std::string& a = args[i];
+        if (a == "--initial") initial = true;
+        else if (a.rfind("--poll-ms=", 0) == 0) {
+            poll_ms = parse_int(a.substr(10));
+            if (poll_ms < 1) { err << "Invalid --poll-ms value.\n"; return 1; }
+        }
+        else { err << "Unknown arg: " << a << "\n"; return 1; }
+    }
+    std::signal(SIGINT, on_watch_signal);
+    std::signal(SIGTERM, on_watch_signal);
+
+    // the store's files are replaced by rename, so it is the directory that
+    // is watched; without inotify, or on a filesystem that doesn't report
+    // changes, the store is checked every --poll-ms
+    int ifd = -1;
+#ifdef __linux__
+    ifd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ifd >= 0 && ::inotify_add_watch(ifd, store_dir().c_str(),
+                                        IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE) < 0) {
+        ::close(ifd);
+        ifd = -1;
+    }
+#endif
+    const std::string prefix = store_name() + '.';
+    const std::string lock = lock_path().filename().string();
+    WatchState s;
+    TaskWriter w(OutFormat::Ndjson, out);
+    check(s, true, initial, w);
+    while (!g_watch_stop && out) {
+        bool wake = ifd < 0;
+#ifdef __linux__
+        if (ifd >= 0) {
+            pollfd p{ifd, POLLIN, 0};
+            wake = ::poll(&p, 1, poll_ms) == 0; // timed out: check anyway
+            alignas(inotify_event) char buf[4096];
+            ssize_t n;
+            while ((n = ::read(ifd, buf, sizeof buf)) > 0) {
+                for (char* e = buf; e < buf + n;) {
+                    const auto* ev = reinterpret_cast<const inotify_event*>(e);
+                    // only this list's files, not its neighbours', and not the
+                    // lock, whose every reader (this one too) closes it for write
+                    const std::string_view name = ev->len ? ev->name : "";
+                    if (name.rfind(prefix, 0) == 0 && lock != name) wake = true;
+                    e += sizeof(inotify_event) + ev->len;
+                }
+            }
+        }
+#endif
+        if (ifd < 0) {
+            for (int slept = 0; slept < poll_ms && !g_watch_stop; slept += 50)
+                std::this_thread::sleep_for(std::chrono::milliseconds(std::min(50, poll_ms - slept)));
+        }
+        if (wake && !g_watch_stop) check(s, false, false, w);
+    }
+#ifdef __linux__
+    if (ifd >= 0) ::close(ifd);
+#endif
+    return 0;
+}
+
+} // namespace tt
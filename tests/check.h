@@ -0,0 +1,61 @@
+// shared by the tests: CHECK notes a failure and carries on, and a test's
+// main returns failures() so ctest sees any of them. commands run in-process
+// through tt::run against stores in scratch directories.
+#pragma once
+
+#include "tt_internal.h"
+
+namespace tt_test {
+
+namespace fs = std::filesystem;
+
+inline int g_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            ++tt_test::g_failures;                                                   \
+        }                                                                            \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                              \
+    do {                                                                                            \
+        const auto& tt_a = (a);                                                                     \
+        const auto& tt_b = (b);                                                                     \
+        if (!(tt_a == tt_b)) {                                                                      \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #a ", " #b ") failed\n  " << tt_a \
+                      << "\n  vs\n  " << tt_b << "\n";                                              \
+            ++tt_test::g_failures;                                                                  \
+        }                                                                                           \
+    } while (0)
+
+inline int failures() {
+    if (g_failures) std::cerr << g_failures << (g_failures == 1 ? " check failed\n" : " checks failed\n");
+    return g_failures ? 1 : 0;
+}
+
+// an empty directory for one test case, under the system temp dir
+inline fs::path scratch(const std::string& name) {
+    std::error_code ec;
+    fs::path dir = fs::temp_directory_path(ec) / ("tt_test_" + name);
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir, ec);
+    return dir;
+}
+
+// one tt command line against the store in dir; what it printed to stdout
+inline std::string run_tt(const fs::path& dir, const std::vector<std::string>& args, int* rc = nullptr) {
+    std::ostringstream out, err;
+    int r = tt::run(dir, args, out, err);
+    if (rc) *rc = r;
+    else if (r != 0) {
+        std::cerr << "tt";
+        for (const auto& a : args) std::cerr << ' ' << a;
+        std::cerr << " failed: " << err.str();
+        ++g_failures;
+    }
+    return out.str();
+}
+
+} // namespace tt_test
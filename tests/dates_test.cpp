@@ -0,0 +1,60 @@
+// due dates: calendar dates only for new input, old stores' dates kept as written
+#include "check.h"
+
+using namespace tt_test;
+
+static void write_file(const fs::path& p, const std::string& text) {
+    std::ofstream f(p, std::ios::binary);
+    f << text;
+}
+
+static std::string read_file(const fs::path& p) {
+    std::ifstream f(p, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+static void new_input_is_checked() {
+    fs::path dir = scratch("dates_new");
+    int rc = 0;
+    run_tt(dir, {"add", "bad", "-d", "2025-02-30"}, &rc);
+    CHECK(rc != 0);
+    run_tt(dir, {"add", "leap", "-d", "2024-02-29"});
+    CHECK_EQ(run_tt(dir, {"list", "--format=tsv"}), std::string("1|0|M|2024-02-29|leap\n"));
+}
+
+// digit dates the first versions accepted survive a load and a rewrite
+static void legacy_dates_survive() {
+    fs::path dir = scratch("dates_legacy");
+    write_file(dir / "tasks.tsv",
+               "1|0|M|2025-02-28|twenty-eighth\n"
+               "2|0|M|2025-03-01|first\n"
+               "3|0|M|2025-02-30|thirtieth\n"
+               "4|0|M|2025-13-45|no such month\n"
+               "5|0|M|-|undated\n");
+    CHECK_EQ(run_tt(dir, {"list", "--format=tsv", "--no-cache"}),
+             std::string("1|0|M|2025-02-28|twenty-eighth\n"
+                         "3|0|M|2025-02-30|thirtieth\n"
+                         "2|0|M|2025-03-01|first\n"
+                         "4|0|M|2025-13-45|no such month\n"
+                         "5|0|M|-|undated\n"));
+    run_tt(dir, {"done", "2"});
+    run_tt(dir, {"compact"});
+    std::string kept = read_file(dir / "tasks.tsv");
+    CHECK(kept.find("3|0|M|2025-02-30|thirtieth\n") != std::string::npos);
+    CHECK(kept.find("4|0|M|2025-13-45|no such month\n") != std::string::npos);
+    // ranges are over real dates, with or without the .due index
+    CHECK_EQ(run_tt(dir, {"list", "--format=tsv", "--due-after=2025-01-01"}),
+             std::string("1|0|M|2025-02-28|twenty-eighth\n2|1|M|2025-03-01|first\n"));
+    run_tt(dir, {"import"});
+    CHECK_EQ(run_tt(dir, {"list", "--format=tsv", "--no-cache", "--pending"}),
+             std::string("1|0|M|2025-02-28|twenty-eighth\n"
+                         "3|0|M|2025-02-30|thirtieth\n"
+                         "4|0|M|2025-13-45|no such month\n"
+                         "5|0|M|-|undated\n"));
+}
+
+int main() {
+    new_input_is_checked();
+    legacy_dates_survive();
+    return failures();
+}
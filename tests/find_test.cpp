@@ -0,0 +1,45 @@
+// tt find --substr: the snapshot scan finds what the in-memory path finds
+#include "check.h"
+
+using namespace tt_test;
+
+// the same command against a Store loaded into memory, as batch and serve run it
+static std::string run_loaded(const fs::path& dir, const std::vector<std::string>& args) {
+    tt::StoreDirScope scope(dir);
+    tt::FileLock lock;
+    CHECK(lock.acquire(tt::FileLock::Shared, true));
+    tt::Store st = tt::Store::open();
+    std::ostringstream out, err;
+    CHECK_EQ(tt::run_command(args, &st, out, err), 0);
+    return out.str();
+}
+
+static void write_file(const fs::path& p, const std::string& text) {
+    std::ofstream f(p, std::ios::binary);
+    f << text;
+}
+
+// needles that also occur in the id, done, priority and due fields, before
+// a title that holds them too
+static void fields_before_title() {
+    fs::path dir = scratch("find_fields");
+    write_file(dir / "tasks.tsv",
+               "1|0|M|-|release v1\n"
+               "2|1|H|2025-03-01|ship M2 in 2025\n"
+               "10|0|L|-|no match here\n"
+               "11|0|M|2025-01-10|last line 10");
+    run_tt(dir, {"add", "journal 1 M"});
+    for (const char* needle : {"1", "M", "0", "2025", "-", "10", "release", "e v", "|", "nothing"}) {
+        std::vector<std::string> args{"find", "--substr", needle, "--sort=id"};
+        CHECK_EQ(run_tt(dir, args), run_loaded(dir, args));
+    }
+    CHECK_EQ(run_tt(dir, {"find", "--substr", "1", "--sort=id", "--format=tsv"}),
+             std::string("1|0|M|-|release v1\n11|0|M|2025-01-10|last line 10\n12|0|M|-|journal 1 M\n"));
+    CHECK_EQ(run_tt(dir, {"find", "--substr", "M", "--sort=id", "--format=tsv"}),
+             std::string("12|0|M|-|journal 1 M\n2|1|H|2025-03-01|ship M2 in 2025\n"));
+}
+
+int main() {
+    fields_before_title();
+    return failures();
+}
@@ -0,0 +1,107 @@
+// structural scan: every TT_SIMD level cuts lines and finds separators the
+// way a byte-at-a-time loop does
+#include "check.h"
+
+#include <random>
+
+using namespace tt_test;
+
+static const tt::ScanLevel LEVELS[] = {tt::ScanLevel::Scalar, tt::ScanLevel::Sse2, tt::ScanLevel::Avx2,
+                                       tt::ScanLevel::Neon, tt::ScanLevel::Auto};
+
+// one line as for_each_tsv_line reports it: its text, then its separators
+static std::string describe(std::string_view line, const uint32_t* seps, unsigned n) {
+    std::string s(line);
+    for (unsigned i = 0; i < n; ++i) s += " @" + std::to_string(seps[i]);
+    return s + '\n';
+}
+
+static std::string scanned(std::string_view buf) {
+    std::string s;
+    tt::for_each_tsv_line(buf, [&](std::string_view line, const uint32_t* seps, unsigned n) {
+        s += describe(line, seps, n);
+    });
+    return s;
+}
+
+static std::string expected(std::string_view buf) {
+    std::string s;
+    size_t start = 0;
+    while (start < buf.size()) {
+        size_t nl = buf.find('\n', start);
+        std::string_view line = buf.substr(start, (nl == std::string_view::npos ? buf.size() : nl) - start);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        uint32_t seps[5];
+        unsigned n = 0;
+        for (size_t i = 0; i < line.size() && n < 5; ++i)
+            if (line[i] == tt::SEP) seps[n++] = static_cast<uint32_t>(i);
+        s += describe(line, seps, n);
+        if (nl == std::string_view::npos) break;
+        start = nl + 1;
+    }
+    return s;
+}
+
+static void check_all_levels(const std::string& buf) {
+    const std::string want = expected(buf);
+    for (tt::ScanLevel l : LEVELS) {
+        tt::g_scan_level = l;
+        CHECK_EQ(scanned(buf), want);
+    }
+    tt::g_scan_level = tt::ScanLevel::Auto;
+}
+
+// '|' or '\n' put at every offset around the 64-byte block boundaries
+static void boundaries() {
+    for (char c : {tt::SEP, '\n'}) {
+        for (size_t at : {0, 1, 62, 63, 64, 65, 126, 127, 128}) {
+            std::string buf(130, 'a');
+            buf[at] = c;
+            check_all_levels(buf);
+            check_all_levels(buf.substr(0, at + 1));
+        }
+    }
+}
+
+static void task_lines() {
+    std::string buf;
+    for (int id = 1; id <= 40; ++id)
+        buf += std::to_string(id) + "|0|M|2025-03-01|a title long enough to straddle blocks " + std::to_string(id) + '\n';
+    check_all_levels(buf);
+    // the last line without its newline, and one ending in \r\n
+    check_all_levels(buf + "41|1|H|-|last line, no newline");
+    check_all_levels(buf + "42|0|L|-|crlf\r\n43|0|L|-|more|pipes|than|five|fields|here\n");
+    // a file of exactly one and two blocks
+    check_all_levels(std::string(63, 'x') + '\n');
+    check_all_levels(std::string(64, '|') + std::string(63, 'y') + '\n');
+    check_all_levels(std::string());
+}
+
+// the block function itself, against random bytes rich in '|' and '\n'
+static void random_blocks() {
+    std::mt19937 rng(7);
+    const char alphabet[] = {'|', '\n', 'a', '\r', '\0', '\x80', '\xff', '0'};
+    for (int round = 0; round < 200; ++round) {
+        char block[64];
+        for (char& c : block) c = alphabet[rng() % sizeof alphabet];
+        uint64_t sep = 0, nl = 0;
+        for (unsigned i = 0; i < 64; ++i) {
+            sep |= static_cast<uint64_t>(block[i] == tt::SEP) << i;
+            nl |= static_cast<uint64_t>(block[i] == '\n') << i;
+        }
+        for (tt::ScanLevel l : LEVELS) {
+            tt::g_scan_level = l;
+            tt::ScanMasks m = tt::scan_block_fn()(block);
+            CHECK_EQ(m.sep, sep);
+            CHECK_EQ(m.nl, nl);
+        }
+    }
+    tt::g_scan_level = tt::ScanLevel::Auto;
+}
+
+int main() {
+    boundaries();
+    task_lines();
+    random_blocks();
+    return failures();
+}
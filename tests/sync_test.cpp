@@ -0,0 +1,146 @@
+// tt sync: copies of a list converge, whatever ids they had before init
+#include "check.h"
+
+using namespace tt_test;
+
+static std::string listing(const fs::path& dir) {
+    return run_tt(dir, {"list", "--sort=id", "--format=tsv", "--no-cache"});
+}
+
+static std::string store_file(const fs::path& dir) {
+    return (dir / "tasks.tsv").string();
+}
+
+// the id of the task titled title in dir's listing; -1 if there is none
+static int id_of(const fs::path& dir, const std::string& title) {
+    std::istringstream in(listing(dir));
+    std::string line;
+    while (std::getline(in, line)) {
+        tt::Task t;
+        if (tt::parse_task(line, t) && t.title == title) return t.id;
+    }
+    return -1;
+}
+
+static size_t count_lines(const std::string& s) {
+    return static_cast<size_t>(std::count(s.begin(), s.end(), '\n'));
+}
+
+// both stores had ids 1 and 2 for different tasks before init
+static void clashing_ids() {
+    fs::path a = scratch("sync_a"), b = scratch("sync_b");
+    run_tt(a, {"add", "alpha"});
+    run_tt(a, {"add", "beta"});
+    run_tt(b, {"add", "gamma"});
+    run_tt(b, {"add", "delta"});
+    run_tt(a, {"sync", "init", "1", "--nodes=10"});
+    run_tt(b, {"sync", "init", "2", "--nodes=10"});
+    run_tt(b, {"sync", "pull", store_file(a)});
+    run_tt(b, {"sync", "push", store_file(a)});
+    CHECK_EQ(listing(a), listing(b));
+    CHECK_EQ(count_lines(listing(a)), 4u);
+    // node 1's tasks keep their ids
+    CHECK_EQ(id_of(a, "alpha"), 1);
+    CHECK_EQ(id_of(b, "beta"), 2);
+
+    // changes to moved tasks, and to the other node's, reach the first copy
+    int gamma = id_of(b, "gamma");
+    CHECK(gamma > 2);
+    run_tt(b, {"done", std::to_string(gamma)});
+    run_tt(b, {"done", "2"});
+    run_tt(b, {"rm", std::to_string(id_of(b, "delta"))});
+    run_tt(a, {"sync", "pull", store_file(b)});
+    CHECK_EQ(listing(a), listing(b));
+    CHECK_EQ(count_lines(listing(a)), 3u);
+
+    // and back the other way, through a compaction
+    run_tt(a, {"done", "1"});
+    run_tt(a, {"compact"});
+    run_tt(a, {"add", "epsilon"});
+    run_tt(b, {"sync", "pull", store_file(a)});
+    CHECK_EQ(listing(a), listing(b));
+}
+
+// three stores each had a different task #1
+static void three_nodes() {
+    fs::path n[3] = {scratch("sync_1"), scratch("sync_2"), scratch("sync_3")};
+    for (int i = 0; i < 3; ++i) {
+        run_tt(n[i], {"add", "first of " + std::to_string(i + 1)});
+        run_tt(n[i], {"sync", "init", std::to_string(i + 1), "--nodes=10"});
+    }
+    // node 2 is the only one that talks to the others
+    for (int round = 0; round < 3; ++round) {
+        run_tt(n[1], {"sync", "pull", store_file(n[0])});
+        run_tt(n[1], {"sync", "pull", store_file(n[2])});
+        run_tt(n[1], {"sync", "push", store_file(n[0])});
+        run_tt(n[1], {"sync", "push", store_file(n[2])});
+    }
+    CHECK_EQ(listing(n[0]), listing(n[1]));
+    CHECK_EQ(listing(n[1]), listing(n[2]));
+    CHECK_EQ(count_lines(listing(n[0])), 3u);
+    CHECK_EQ(id_of(n[2], "first of 1"), 1);
+
+    run_tt(n[2], {"done", std::to_string(id_of(n[2], "first of 2"))});
+    run_tt(n[1], {"sync", "pull", store_file(n[2])});
+    run_tt(n[1], {"sync", "push", store_file(n[0])});
+    CHECK_EQ(listing(n[0]), listing(n[2]));
+}
+
+// both stores started as copies of one file, as after an rsync
+static void shared_copies() {
+    fs::path a = scratch("sync_copy_a"), b = scratch("sync_copy_b");
+    run_tt(a, {"add", "shared", "-p", "H"});
+    run_tt(b, {"add", "shared", "-p", "H"});
+    run_tt(a, {"sync", "init", "1", "--nodes=10"});
+    run_tt(b, {"sync", "init", "2", "--nodes=10"});
+    run_tt(b, {"done", "1"});
+    run_tt(b, {"sync", "pull", store_file(a)});
+    run_tt(b, {"sync", "push", store_file(a)});
+    CHECK_EQ(listing(a), listing(b));
+    CHECK_EQ(listing(a), std::string("1|1|H|-|shared\n"));
+}
+
+// nodes take ids of their own, and a second pull sends nothing
+static void node_ids() {
+    fs::path a = scratch("sync_ids_a"), b = scratch("sync_ids_b");
+    run_tt(a, {"sync", "init", "1", "--nodes=10"});
+    run_tt(b, {"sync", "init", "2", "--nodes=10"});
+    run_tt(a, {"add", "one"});
+    run_tt(b, {"add", "two"});
+    CHECK_EQ(id_of(a, "one") % 10, 1);
+    CHECK_EQ(id_of(b, "two") % 10, 2);
+    run_tt(b, {"sync", "pull", store_file(a)});
+    CHECK_EQ(run_tt(b, {"sync", "pull", store_file(a)}), std::string("Applied 0 changes from node 1.\n"));
+    int rc = 0;
+    run_tt(b, {"sync", "pull", store_file(b)}, &rc);
+    CHECK(rc != 0);
+}
+
+// a task removed here before its owner's copy of it was ever pulled comes
+// back with the pull, and done and rm reach it afterwards
+static void removed_then_pulled() {
+    fs::path a = scratch("sync_rm_a"), b = scratch("sync_rm_b");
+    for (const fs::path& d : {a, b}) {
+        run_tt(d, {"add", "alpha"});
+        run_tt(d, {"add", "beta"});
+        run_tt(d, {"compact"});
+    }
+    run_tt(a, {"sync", "init", "1", "--nodes=10"});
+    run_tt(b, {"sync", "init", "2", "--nodes=10"});
+    run_tt(b, {"rm", "1"});
+    run_tt(b, {"sync", "pull", store_file(a)});
+    CHECK_EQ(listing(b), std::string("1|0|M|-|alpha\n2|0|M|-|beta\n"));
+    CHECK_EQ(run_tt(b, {"done", "1"}), std::string("Marked #1 done.\n"));
+    CHECK_EQ(listing(b), std::string("2|0|M|-|beta\n1|1|M|-|alpha\n"));
+    CHECK_EQ(run_tt(b, {"rm", "1"}), std::string("Removed #1.\n"));
+    CHECK_EQ(listing(b), std::string("2|0|M|-|beta\n"));
+}
+
+int main() {
+    clashing_ids();
+    three_nodes();
+    shared_copies();
+    node_ids();
+    removed_then_pulled();
+    return failures();
+}